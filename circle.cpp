@@ -1,7 +1,11 @@
+// keep windows.h from defining min/max macros that break std::max in the circle engine
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 #include <GL/gl.h>
 #include <iostream>
 #include <cmath>
+#include "midpoint circle engine.h"
 
 using namespace std;
 
@@ -17,48 +21,17 @@ void init() {
     glMatrixMode(GL_MODELVIEW);
 }
 
-void putPixel(int x, int y) {
-    glBegin(GL_POINTS);
-    glVertex2i(x, y);
-    glEnd();
-}
-
-// Function to draw all 8 symmetric points
-void plotCirclePoints(int xc, int yc, int x, int y) {
-    putPixel(xc + x, yc + y);
-    putPixel(xc - x, yc + y);
-    putPixel(xc + x, yc - y);
-    putPixel(xc - x, yc - y);
-    putPixel(xc + y, yc + x);
-    putPixel(xc - y, yc + x);
-    putPixel(xc + y, yc - x);
-    putPixel(xc - y, yc - x);
-}
-
-// Midpoint Circle Algorithm
+// Midpoint Circle Algorithm: the engine fills one contiguous buffer with all
+// eight octants, which is then submitted as a single vertex array.
 void midpointCircle(int xc, int yc, int r) {
-    int x = 0;
-    int y = r;
-    int p = 1 - r;  // Initial decision parameter
-
-    // Plot first set of points
-    plotCirclePoints(xc, yc, x, y);
-
-    while (x < y) {
-        x++;
-
-        if (p < 0) {
-            // Select E (East) pixel
-            p = p + 2 * x + 1;
-        } else {
-            // Select SE (South-East) pixel
-            y--;
-            p = p + 2 * (x - y) + 1;
-        }
-
-        // Plot the calculated points in all octants
-        plotCirclePoints(xc, yc, x, y);
-    }
+    static CircleScratch scratch;
+    scratch.points.clear();
+    emitCirclePoints({xc, yc, r}, scratch);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_INT, sizeof(CirclePoint), scratch.points.data());
+    glDrawArrays(GL_POINTS, 0, (GLsizei)scratch.points.size());
+    glDisableClientState(GL_VERTEX_ARRAY);
 }
 
 void display() {
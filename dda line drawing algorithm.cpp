@@ -2,11 +2,94 @@
 #include <iostream>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <thread>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "raster bitmap.h"
+#include "dda line kernels.h"
 
 using namespace std;
 
-// Global variables to store line coordinates
-int startX, startY, endX, endY;
+// ================= Console input =================
+// Coordinates are read from cin on a separate thread and handed to the GLUT
+// loop through a lock-free single-producer/single-consumer ring, so typing
+// never blocks repainting. A timer polls the ring once per frame.
+
+const int FRAME_MS = 16;
+
+struct LineRequest {
+    Segment seg;
+    chrono::steady_clock::time_point parsed;  // when the reader finished the line
+};
+
+template <class T, size_t N>
+class SpscQueue {
+public:
+    bool push(const T& v) {
+        size_t t = tail.load(memory_order_relaxed);
+        size_t next = (t + 1) % N;
+        if (next == head.load(memory_order_acquire)) return false;  // full
+        buf[t] = v;
+        tail.store(next, memory_order_release);
+        return true;
+    }
+    bool pop(T& v) {
+        size_t h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire)) return false;  // empty
+        v = buf[h];
+        head.store((h + 1) % N, memory_order_release);
+        return true;
+    }
+
+private:
+    T buf[N];
+    alignas(64) atomic<size_t> head{0};
+    alignas(64) atomic<size_t> tail{0};
+};
+
+SpscQueue<LineRequest, 4096> inputQueue;
+vector<Segment> lines;                       // every line entered so far (render thread only)
+vector<LineRequest> awaitingDisplay;          // drained but not yet drawn
+
+// Latency: parsed on the reader thread -> first frame that shows it.
+// Stall: how late each timer tick fires compared to FRAME_MS.
+struct InputStats {
+    size_t lines = 0;
+    double latencySumMs = 0, latencyMaxMs = 0;
+    size_t ticks = 0;
+    double stallSumMs = 0, stallMaxMs = 0;
+    chrono::steady_clock::time_point lastTick;
+} stats;
+
+double msBetween(chrono::steady_clock::time_point a, chrono::steady_clock::time_point b) {
+    return chrono::duration<double, milli>(b - a).count();
+}
+
+void printPrompt() {
+    cout << "Enter a line as: x1 y1 x2 y2 (several lines may be pasted at once)" << endl;
+}
+
+void inputReader() {
+    cout << "\n=== DDA Line Drawing Algorithm ===" << endl;
+    printPrompt();
+    int x1, y1, x2, y2;
+    while (true) {
+        if (!(cin >> x1 >> y1 >> x2 >> y2)) {
+            if (cin.eof()) return;
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            cout << "Expected four integers: x1 y1 x2 y2" << endl;
+            continue;
+        }
+        LineRequest req = {{x1, y1, x2, y2}, chrono::steady_clock::now()};
+        while (!inputQueue.push(req)) this_thread::yield();  // ring full: wait for the GLUT loop
+    }
+}
 
 void init() {
     glClearColor(1.0, 1.0, 1.0, 1.0);  // White background
@@ -16,32 +99,14 @@ void init() {
     glMatrixMode(GL_MODELVIEW);
 }
 
+// Callers bracket a run of pixels with a single glBegin/glEnd.
 void setPixel(int x, int y) {
-    glBegin(GL_POINTS);
     glVertex2i(x, y);
-    glEnd();
 }
 
 void ddaLine(int x1, int y1, int x2, int y2) {
-    int dx = x2 - x1;
-    int dy = y2 - y1;
-    
-    // Calculate steps required for generating pixels
-    int steps = max(abs(dx), abs(dy));
-    
-    // Calculate increment in x & y for each step
-    float xIncrement = float(dx) / float(steps);
-    float yIncrement = float(dy) / float(steps);
-    
-    // Put pixel for each step
-    float x = x1;
-    float y = y1;
-    
-    for (int i = 0; i <= steps; i++) {
-        setPixel(round(x), round(y));
-        x += xIncrement;
-        y += yIncrement;
-    }
+    // Same DDA the batch mode uses; see "dda line kernels.h"
+    ddaLineKernel(x1, y1, x2, y2, setPixel);
 }
 
 void display() {
@@ -51,55 +116,237 @@ void display() {
     glColor3f(1.0, 0.0, 0.0);
     glPointSize(2.0);
     
-    // Draw the line using DDA algorithm
-    ddaLine(startX, startY, endX, endY);
+    // Draw the lines using DDA algorithm
+    glBegin(GL_POINTS);
+    for (const Segment& l : lines) ddaLine(l.x1, l.y1, l.x2, l.y2);
+    glEnd();
     
     // Draw coordinate axes for reference
     glColor3f(0.5, 0.5, 0.5);
     glPointSize(1.0);
     
+    glBegin(GL_POINTS);
     // Draw X-axis
     ddaLine(0, 300, 800, 300);
     
     // Draw Y-axis
     ddaLine(400, 0, 400, 600);
+    glEnd();
     
     glFlush();
+
+    auto now = chrono::steady_clock::now();
+    for (const LineRequest& r : awaitingDisplay) {
+        double ms = msBetween(r.parsed, now);
+        stats.latencySumMs += ms;
+        stats.latencyMaxMs = max(stats.latencyMaxMs, ms);
+        stats.lines++;
+    }
+    awaitingDisplay.clear();
 }
 
-void getUserInput() {
-    cout << "\n=== DDA Line Drawing Algorithm ===" << endl;
-    cout << "Enter coordinates for the line:" << endl;
-    
-    cout << "Enter starting point (x1, y1): ";
-    cin >> startX >> startY;
-    
-    cout << "Enter ending point (x2, y2): ";
-    cin >> endX >> endY;
-    
-    cout << "\nLine will be drawn from (" << startX << ", " << startY << ") to (" << endX << ", " << endY << ")" << endl;
-    cout << "Close the graphics window to draw another line or exit." << endl;
+void pollInput(int) {
+    auto now = chrono::steady_clock::now();
+    if (stats.ticks++ > 0) {
+        double late = max(0.0, msBetween(stats.lastTick, now) - FRAME_MS);
+        stats.stallSumMs += late;
+        stats.stallMaxMs = max(stats.stallMaxMs, late);
+    }
+    stats.lastTick = now;
+
+    LineRequest req;
+    bool any = false;
+    while (inputQueue.pop(req)) {
+        lines.push_back(req.seg);
+        awaitingDisplay.push_back(req);
+        cout << "Line from (" << req.seg.x1 << ", " << req.seg.y1 << ") to (" << req.seg.x2 << ", " << req.seg.y2 << ")" << endl;
+        any = true;
+    }
+    if (any) glutPostRedisplay();
+    glutTimerFunc(FRAME_MS, pollInput, 0);
+}
+
+void printStats() {
+    cout << "\nLines drawn: " << stats.lines;
+    if (stats.lines) cout << ", input latency avg " << stats.latencySumMs / stats.lines << " ms, max " << stats.latencyMaxMs << " ms";
+    cout << endl;
+    if (stats.ticks > 1) {
+        cout << "Event loop: " << stats.ticks << " ticks, late by avg " << stats.stallSumMs / (stats.ticks - 1)
+             << " ms, max " << stats.stallMaxMs << " ms" << endl;
+    }
 }
 
 void keyboard(unsigned char key, int x, int y) {
     if (key == 27) { // ESC key
+        printStats();
         exit(0);
     } else if (key == 'n' || key == 'N') {
-        getUserInput();
+        printPrompt();
+    } else if (key == 'c' || key == 'C') {
+        lines.clear();
         glutPostRedisplay();
     }
 }
 
 void displayMenu() {
     cout << "\nControls:" << endl;
-    cout << "Press 'N' to draw a new line" << endl;
-    cout << "Press 'ESC' to exit" << endl;
+    cout << "Type coordinates in this console at any time to add lines" << endl;
+    cout << "Press 'N' to show the input format" << endl;
+    cout << "Press 'C' to clear the lines" << endl;
+    cout << "Press 'ESC' to exit (prints latency / stall stats)" << endl;
+}
+
+// ================= Batch mode =================
+// dda --batch <segments> [--kernel dda|bresenham|simd] [--threads N] [--size WxH] [--out image.pgm]
+// dda --generate <count> <segments.bin> [--size WxH]
+//
+// Segment files are either binary ("SEG1" followed by little-endian int32
+// x1 y1 x2 y2 records) or text (four integers per segment, '#' comments).
+// Segments are clipped to the bitmap before rasterizing, so one long
+// segment far off the target costs only its visible steps.
+
+typedef void (*LineKernel)(const Segment*, size_t, Bitmap&);
+
+void rasterDDA(const Segment* s, size_t n, Bitmap& bmp) {
+    auto plot = [&bmp](int x, int y) { bmp.set(x, y); };
+    for (size_t i = 0; i < n; i++) {
+        Segment c = s[i];
+        if (clipSegment(c, bmp.w, bmp.h)) ddaLineKernel(c.x1, c.y1, c.x2, c.y2, plot);
+    }
+}
+
+void rasterBresenham(const Segment* s, size_t n, Bitmap& bmp) {
+    auto plot = [&bmp](int x, int y) { bmp.set(x, y); };
+    for (size_t i = 0; i < n; i++) {
+        Segment c = s[i];
+        if (clipSegment(c, bmp.w, bmp.h)) bresenhamLineKernel(c.x1, c.y1, c.x2, c.y2, plot);
+    }
+}
+
+void rasterSimd(const Segment* s, size_t n, Bitmap& bmp) {
+    auto plot = [&bmp](int x, int y) { bmp.set(x, y); };
+    for (size_t i = 0; i < n; i++) {
+        Segment c = s[i];
+        if (clipSegment(c, bmp.w, bmp.h)) ddaLineSimdKernel(c.x1, c.y1, c.x2, c.y2, plot);
+    }
+}
+
+bool loadSegments(const MappedFile& file, vector<Segment>& out, const Segment*& view, size_t& count) {
+    const char* data = file.data();
+    size_t len = file.size();
+    if (len >= 4 && memcmp(data, "SEG1", 4) == 0) {
+        // binary records are used in place, no copy
+        if ((len - 4) % sizeof(Segment) != 0) return false;
+        view = reinterpret_cast<const Segment*>(data + 4);
+        count = (len - 4) / sizeof(Segment);
+        return true;
+    }
+    vector<int> vals;
+    if (!parseIntText(data, data + len, vals) || vals.size() % 4 != 0) return false;
+    for (size_t i = 0; i < vals.size(); i += 4) out.push_back({vals[i], vals[i + 1], vals[i + 2], vals[i + 3]});
+    view = out.data();
+    count = out.size();
+    return true;
+}
+
+bool parseSize(const char* s, int& w, int& h) {
+    return sscanf(s, "%dx%d", &w, &h) == 2 && w > 0 && h > 0;
+}
+
+double msSince(chrono::steady_clock::time_point t0) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+}
+
+int generateSegments(size_t count, const string& path, int w, int h) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+        cerr << "Cannot write " << path << endl;
+        return 1;
+    }
+    fwrite("SEG1", 1, 4, f);
+    mt19937 rng(12345);
+    uniform_int_distribution<int> rx(0, w - 1), ry(0, h - 1);
+    vector<Segment> chunk;
+    chunk.reserve(1 << 16);
+    for (size_t i = 0; i < count; i++) {
+        chunk.push_back({rx(rng), ry(rng), rx(rng), ry(rng)});
+        if (chunk.size() == chunk.capacity() || i + 1 == count) {
+            fwrite(chunk.data(), sizeof(Segment), chunk.size(), f);
+            chunk.clear();
+        }
+    }
+    fclose(f);
+    cout << "Wrote " << count << " segments to " << path << endl;
+    return 0;
+}
+
+int runBatch(int argc, char** argv) {
+    string input, out = "lines.pgm", kernelName = "dda";
+    int threads = 1, w = 800, h = 600;
+    size_t generateCount = 0;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        bool more = i + 1 < argc;
+        if (a == "--batch" && more) input = argv[++i];
+        else if (a == "--generate" && i + 2 < argc) { generateCount = strtoull(argv[++i], NULL, 10); input = argv[++i]; }
+        else if (a == "--kernel" && more) kernelName = argv[++i];
+        else if (a == "--threads" && more) threads = atoi(argv[++i]);
+        else if (a == "--out" && more) out = argv[++i];
+        else if (a == "--size" && more) {
+            if (!parseSize(argv[++i], w, h)) { cerr << "Bad --size, expected WxH" << endl; return 1; }
+        } else {
+            cerr << "Unknown or incomplete option: " << a << endl;
+            return 1;
+        }
+    }
+    if (generateCount) return generateSegments(generateCount, input, w, h);
+
+    LineKernel kernel = NULL;
+    if (kernelName == "dda") kernel = rasterDDA;
+    else if (kernelName == "bresenham") kernel = rasterBresenham;
+    else if (kernelName == "simd") kernel = rasterSimd;
+    if (!kernel) {
+        cerr << "Unknown kernel '" << kernelName << "' (dda, bresenham, simd)" << endl;
+        return 1;
+    }
+    if (threads < 1) threads = max(1u, thread::hardware_concurrency());
+
+    auto t0 = chrono::steady_clock::now();
+    MappedFile file;
+    vector<Segment> parsed;
+    const Segment* segs = NULL;
+    size_t count = 0;
+    if (!file.open(input) || !loadSegments(file, parsed, segs, count)) {
+        cerr << "Cannot read segments from " << input << endl;
+        return 1;
+    }
+    double loadMs = msSince(t0);
+
+    Bitmap bmp(w, h);
+    t0 = chrono::steady_clock::now();
+    rasterizeParallel(bmp, count, threads, [&](Bitmap& target, size_t begin, size_t end) {
+        kernel(segs + begin, end - begin, target);
+    });
+    double rasterMs = msSince(t0);
+
+    t0 = chrono::steady_clock::now();
+    if (!writePGM(bmp, out)) {
+        cerr << "Cannot write " << out << endl;
+        return 1;
+    }
+    double writeMs = msSince(t0);
+
+    cout << "kernel=" << kernelName << " threads=" << threads << " segments=" << count
+         << " size=" << w << "x" << h << " covered=" << bmp.countSet() << endl;
+    cout << "load " << loadMs << " ms, raster+merge " << rasterMs << " ms, write " << writeMs << " ms" << endl;
+    if (rasterMs > 0) cout << (count / rasterMs) * 1000.0 << " segments/s" << endl;
+    cout << "Image written to " << out << endl;
+    return 0;
 }
 
 int main(int argc, char** argv) {
-    // Get user input for line coordinates
-    getUserInput();
-    
+    if (argc > 1) return runBatch(argc, argv);
+
     // Initialize GLUT
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_SINGLE | GLUT_RGB);
@@ -113,9 +360,11 @@ int main(int argc, char** argv) {
     // Set callback functions
     glutDisplayFunc(display);
     glutKeyboardFunc(keyboard);
+    glutTimerFunc(FRAME_MS, pollInput, 0);
     
-    // Display menu
+    // Display menu, then start reading coordinates in the background
     displayMenu();
+    thread(inputReader).detach();
     
     // Start the main loop
     glutMainLoop();
@@ -0,0 +1,127 @@
+// dda line kernels.h
+// Line rasterization kernels that emit pixels through a callback, so the same
+// code can feed glVertex2i or a CPU bitmap.
+#ifndef DDA_LINE_KERNELS_H
+#define DDA_LINE_KERNELS_H
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+struct Segment {
+    int x1, y1, x2, y2;
+};
+
+// Clip s to the pixels of a w x h target (Liang-Barsky, in double so
+// coordinates anywhere in the int range are safe). Returns false if no pixel
+// of the segment is inside. Segments already inside are left untouched; a
+// clipped one gets rounded endpoints on the border, so its pixels near the
+// edge can differ by one from the unclipped line.
+inline bool clipSegment(Segment& s, int w, int h) {
+    if ((unsigned)s.x1 < (unsigned)w && (unsigned)s.y1 < (unsigned)h &&
+        (unsigned)s.x2 < (unsigned)w && (unsigned)s.y2 < (unsigned)h) return true;
+    double x0 = s.x1, y0 = s.y1;
+    double dx = (double)s.x2 - s.x1, dy = (double)s.y2 - s.y1;
+    // pixel centers are integers, so the target spans [-0.5, w - 0.5]
+    const double p[4] = {-dx, dx, -dy, dy};
+    const double q[4] = {x0 + 0.5, w - 0.5 - x0, y0 + 0.5, h - 0.5 - y0};
+    double t0 = 0.0, t1 = 1.0;
+    for (int k = 0; k < 4; k++) {
+        if (p[k] == 0.0) {
+            if (q[k] < 0.0) return false;
+        } else {
+            double r = q[k] / p[k];
+            if (p[k] < 0.0) t0 = (std::max)(t0, r);
+            else t1 = (std::min)(t1, r);
+        }
+    }
+    if (t0 > t1) return false;
+    auto snap = [](double v, int n) { return (std::min)((std::max)((int)std::floor(v + 0.5), 0), n - 1); };
+    s.x1 = snap(x0 + t0 * dx, w); s.y1 = snap(y0 + t0 * dy, h);
+    s.x2 = snap(x0 + t1 * dx, w); s.y2 = snap(y0 + t1 * dy, h);
+    return true;
+}
+
+// Floating-point DDA, exactly as the interactive program draws it:
+// accumulate the increments and round each step.
+template <class Plot>
+inline void ddaLineKernel(int x1, int y1, int x2, int y2, Plot plot) {
+    long long dx = (long long)x2 - x1;  // long long: int endpoints can be 2^32 apart
+    long long dy = (long long)y2 - y1;
+    long long steps = (std::max)(std::abs(dx), std::abs(dy));
+    if (steps == 0) {
+        plot(x1, y1);
+        return;
+    }
+    float xIncrement = float(dx) / float(steps);
+    float yIncrement = float(dy) / float(steps);
+    float x = x1;
+    float y = y1;
+    for (long long i = 0; i <= steps; i++) {
+        plot((int)std::round(x), (int)std::round(y));
+        x += xIncrement;
+        y += yIncrement;
+    }
+}
+
+// Integer Bresenham for all octants.
+template <class Plot>
+inline void bresenhamLineKernel(int x1, int y1, int x2, int y2, Plot plot) {
+    long long dx = std::abs((long long)x2 - x1);  // long long, as in ddaLineKernel
+    long long dy = -std::abs((long long)y2 - y1);
+    int sx = x1 < x2 ? 1 : -1, sy = y1 < y2 ? 1 : -1;
+    long long err = dx + dy;
+    for (;;) {
+        plot(x1, y1);
+        if (x1 == x2 && y1 == y2) break;
+        long long e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x1 += sx; }
+        if (e2 <= dx) { err += dx; y1 += sy; }
+    }
+}
+
+// DDA evaluated four steps at a time. Positions are computed as x1 + i*xi
+// instead of by accumulation, so long lines drift less than ddaLineKernel;
+// ties round up (floor(v + 0.5)).
+template <class Plot>
+inline void ddaLineSimdKernel(int x1, int y1, int x2, int y2, Plot plot) {
+    long long dx = (long long)x2 - x1;  // long long: int endpoints can be 2^32 apart
+    long long dy = (long long)y2 - y1;
+    long long steps = (std::max)(std::abs(dx), std::abs(dy));
+    if (steps == 0) {
+        plot(x1, y1);
+        return;
+    }
+    float xi = float(dx) / float(steps);
+    float yi = float(dy) / float(steps);
+    long long i = 0;
+#ifdef __SSE2__
+    const __m128 lane = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128 vxi = _mm_set1_ps(xi), vyi = _mm_set1_ps(yi);
+    const __m128 vx1 = _mm_set1_ps((float)x1), vy1 = _mm_set1_ps((float)y1);
+    alignas(16) int xs[4], ys[4];
+    for (; i + 3 <= steps; i += 4) {
+        __m128 t = _mm_add_ps(_mm_set1_ps((float)i), lane);
+        __m128 fx = _mm_add_ps(_mm_add_ps(vx1, _mm_mul_ps(t, vxi)), half);
+        __m128 fy = _mm_add_ps(_mm_add_ps(vy1, _mm_mul_ps(t, vyi)), half);
+        // floor = truncate, then step down where truncation went up (negatives)
+        __m128i ix = _mm_cvttps_epi32(fx), iy = _mm_cvttps_epi32(fy);
+        ix = _mm_sub_epi32(ix, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(ix), fx)), one));
+        iy = _mm_sub_epi32(iy, _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(iy), fy)), one));
+        _mm_store_si128((__m128i*)xs, ix);
+        _mm_store_si128((__m128i*)ys, iy);
+        plot(xs[0], ys[0]); plot(xs[1], ys[1]); plot(xs[2], ys[2]); plot(xs[3], ys[3]);
+    }
+#endif
+    for (; i <= steps; i++) {
+        plot((int)std::floor(x1 + i * xi + 0.5f), (int)std::floor(y1 + i * yi + 0.5f));
+    }
+}
+
+#endif
@@ -2,86 +2,99 @@
 // City After Rain  Refined Cinematic Edition
 // Features: directional lighting, day-night cycle, improved rain physics, blurred reflections,
 // smarter traffic & pedestrian logic, simplified bloom, camera timeline.
-// Compile: g++ city_after_rain_refined.cpp -o city_after_rain_refined -lGL -lGLU -lglut -std=c++11
+// Compile: g++ city_after_rain_refined.cpp -o city_after_rain_refined -lGL -lGLU -lglut -std=c++11 -pthread
+// Run with --profile for per-section timings and hardware counters (Linux perf_event_open).
+// Headless (no window, no GPU): add -DHEADLESS_EGL -lEGL and run with --headless N, see runHeadless();
+// --workers W splits the frames across W processes, see runFrameParallel().
+// --control PATH opens a Unix-socket endpoint for live tuning and metrics, see serveControl().
 
 #include <GL/glut.h>
 #include <cmath>
 #include <vector>
 #include <cstdlib>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
 #include <algorithm>
 #include <iostream>
+#include <cstdio>
+#include <cerrno>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "raster primitives.h"
+#include "perf counters.h"
+
+#ifdef HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
 
 constexpr double PI = 3.14159265358979323846;
 
 // ---------------------- TUNABLE PARAMETERS ----------------------
-int WIN_W = 1280;
+int WIN_W = 1280;                   // window size in pixels (changes on reshape)
 int WIN_H = 780;
+const int WORLD_W = 1280;           // world units; the scene never depends on window size
+const int WORLD_H = 780;
 const int FRAME_MS = 16;
+float RENDER_SCALE = 1.0f;          // internal resolution relative to the window
+bool AUTO_RENDER_SCALE = false;     // let frame time drive RENDER_SCALE ('a')
+const float MIN_RENDER_SCALE = 0.4f;
 float TIME_SCALE = 1.0f;            // speed of simulated time
+const float MAX_TIME_SCALE = 100.0f;
+unsigned SCENE_SEED = 0;            // 0 = seed from the clock (--seed S for a repeatable city)
 int RAIN_PARTICLES = 900;           // drop count (reduce if slow)
 int MAX_SPLASHES = 160;
 bool ENABLE_CINEMATIC = true;
-bool ENABLE_BLOOM = true;
+bool ENABLE_BLOOM = true;           // light pass: glow of headlights, signal lamps, windows and sun
 bool ENABLE_GRAIN = true;
+bool ENABLE_PIPELINE = true;        // simulate on its own thread (needs 2+ cores)
+bool ENABLE_PROFILING = false;      // per-section counters (also --profile on the command line)
+const int PROFILE_PRINT_EVERY = 60; // frames between per-frame tables
 // ----------------------------------------------------------------
 
-float simTime = 0.0f; // seconds
-bool raining = true;
-bool autoCamera = true;
-bool cinematic = true;
-bool dayMode = false; // toggled with 'd'
+bool cinematic = true; // render-side option ('c')
 
 // Simple directional light (sun/moon)
 struct Sun {
     float angle; // overhead rotation 0..2pi
-} sun{0.9f};
+};
 
 const int GROUND_Y = 140;
 
-// ----- low-level draw primitives (DDA, midpoint) -----
+// ----- low-level draw primitives (DDA, midpoint); rasterizers live in raster primitives.h -----
 void putPixel(int x, int y) { glVertex2i(x, y); }
 
 void drawLineDDA(int x1,int y1,int x2,int y2){
-    int dx = x2-x1, dy=y2-y1;
-    int steps = std::max(abs(dx), abs(dy));
-    if(steps==0){ glBegin(GL_POINTS); putPixel(x1,y1); glEnd(); return; }
-    float x=x1,y=y1, xi=dx/(float)steps, yi=dy/(float)steps;
-    glBegin(GL_POINTS);
-    for(int i=0;i<=steps;i++){ putPixel((int)(x+0.5f),(int)(y+0.5f)); x+=xi; y+=yi; }
-    glEnd();
+    glBegin(GL_POINTS); rasterLineDDA(x1,y1,x2,y2, putPixel); glEnd();
 }
 
 void drawCircleMidpoint(int cx,int cy,int r){
-    int x=0,y=r; int d=1-r;
-    glBegin(GL_POINTS);
-    auto plot8=[&](int px,int py){
-        putPixel(cx+px, cy+py); putPixel(cx-px, cy+py);
-        putPixel(cx+px, cy-py); putPixel(cx-px, cy-py);
-        putPixel(cx+py, cy+px); putPixel(cx-py, cy+px);
-        putPixel(cx+py, cy-px); putPixel(cx-py, cy-px);
-    };
-    while(x<=y){
-        plot8(x,y);
-        if(d<0) d+=2*x+3; else { d+=2*(x-y)+5; y--; }
-        x++;
-    }
-    glEnd();
+    glBegin(GL_POINTS); rasterCircleMidpoint(cx,cy,r, putPixel); glEnd();
 }
 
 void drawFilledCircle(int cx,int cy,int r){
-    for(int dy=-r;dy<=r;++dy){
-        int dx = (int)floor(sqrt((double)r*r - dy*dy));
-        glBegin(GL_POINTS);
-        for(int x=-dx;x<=dx;++x) putPixel(cx+x, cy+dy);
-        glEnd();
-    }
+    glBegin(GL_POINTS); rasterFilledCircle(cx,cy,r, putPixel); glEnd();
 }
 
 void drawFilledRect(int x,int y,int w,int h){
-    glBegin(GL_POINTS);
-    for(int yy=y; yy<y+h; ++yy) for(int xx=x; xx<x+w; ++xx) putPixel(xx,yy);
-    glEnd();
+    glBegin(GL_POINTS); rasterFilledRect(x,y,w,h, putPixel); glEnd();
 }
 
 void drawRectAlpha(int x,int y,int w,int h, float r,float g,float b,float a){
@@ -94,22 +107,408 @@ void drawRectAlpha(int x,int y,int w,int h, float r,float g,float b,float a){
 // utility: clamp
 float clampf(float v,float lo,float hi){ return v<lo?lo:(v>hi?hi:v); }
 
+bool isDaytime(float sunAngle){ return cosf(sunAngle) > -0.2f; } // crude day detect
+
+// ------------------ Profiling sections ------------------
+// Sim sections run on the sim thread, render sections on the GLUT thread;
+// each thread has its own counters. Render sections time the CPU side of
+// issuing GL commands, not the GPU work behind them.
+enum ProfileSection {
+    PROF_SIM_TICK, PROF_WINDOWS, PROF_RAIN, PROF_AGENT_SPEEDS, PROF_PEOPLE, PROF_MOVE_AGENTS, PROF_CAMERA,
+    PROF_FRAME, PROF_LIGHT_SPLAT, PROF_SKY, PROF_BUILDINGS, PROF_REFLECTIONS, PROF_GROUND, PROF_PEOPLE_DRAW, PROF_VEHICLES,
+    PROF_LIGHT_COMPOSITE, PROF_ROAD_REFLECTIONS, PROF_RAIN_DRAW, PROF_CLOUDS, PROF_UPSCALE, PROF_OVERLAYS, PROF_SECTION_COUNT
+};
+
+const char* profileSectionNames[PROF_SECTION_COUNT] = {
+    "sim tick", "  windows", "  rain", "  agent speeds", "  people", "  move agents", "  camera",
+    "frame", "  light splat", "  sky", "  buildings", "  reflections", "  ground", "  people draw", "  vehicles",
+    "  light composite", "  road reflections", "  rain draw", "  clouds front", "  upscale", "  overlays"
+};
+
+PerfProfiler profiler(profileSectionNames, PROF_SECTION_COUNT);
+
 // ------------------ Scene objects ------------------
 struct Building {
     int x,y,w,h;
     float baseR, baseG, baseB;
     bool brightWindows;
     int roofType;
+    int winCols, winRows; // window grid (18 x 22 unit pitch)
+    int litRow;           // first row of this building in SceneState::windowLit
+};
+
+// Window lights change through scheduled events instead of per-frame dice.
+// Hashed timer wheel: an event due in d ticks goes into slot (now+d) % WHEEL_SLOTS
+// and waits d / WHEEL_SLOTS extra laps, so scheduling is O(1) and each tick
+// only visits the one slot that is due.
+struct WindowEvent {
+    uint32_t building;
+    uint16_t window;  // row * winCols + col
+    uint16_t laps;    // full wheel turns still to wait
+};
+
+class TimerWheel {
+public:
+    enum { WHEEL_SLOTS = 256 };
+
+    void clear(){ for(auto &slot : slots) slot.clear(); now = 0; }
+
+    void schedule(uint32_t delay, uint32_t building, int window){
+        WindowEvent e = { building, (uint16_t)window, (uint16_t)(delay / WHEEL_SLOTS) };
+        slots[(now + delay) % WHEEL_SLOTS].push_back(e);
+    }
+
+    // run the events due this tick; fire() may schedule new ones
+    template <class Fire>
+    void advance(Fire fire){
+        size_t cur = now++ % WHEEL_SLOTS;
+        due.swap(slots[cur]);
+        for(auto &e : due){
+            if(e.laps){ e.laps--; slots[cur].push_back(e); }
+            else fire(e);
+        }
+        due.clear();
+    }
+
+private:
+    std::vector<WindowEvent> slots[WHEEL_SLOTS];
+    std::vector<WindowEvent> due;
+    uint32_t now = 0;
+};
+
+// Rain is kept as parallel arrays (one per field) so the per-drop collision
+// pass streams through memory and vectorizes even at 1M drops.
+struct RainField {
+    std::vector<float> x, y;
+    std::vector<float> vx, vy;
+    std::vector<float> len;
+    std::vector<uint8_t> alive; // still above the surface below it (set by the collision pass)
+
+    size_t size() const { return x.size(); }
+    void clear(){ x.clear(); y.clear(); vx.clear(); vy.clear(); len.clear(); alive.clear(); }
+    void reserve(size_t n){ x.reserve(n); y.reserve(n); vx.reserve(n); vy.reserve(n); len.reserve(n); alive.reserve(n); }
+    void push(float px,float py,float pvx,float pvy,float plen){
+        x.push_back(px); y.push_back(py); vx.push_back(pvx); vy.push_back(pvy); len.push_back(plen); alive.push_back(1);
+    }
+    void truncate(size_t n){ x.resize(n); y.resize(n); vx.resize(n); vy.resize(n); len.resize(n); alive.resize(n); }
+};
+
+struct Splash {
+    float x,y;
+    float radius;
+    float life;
+};
+
+// ----- Scene agents: packed entity/component store -----
+// Cars, bikes, pedestrians and clouds are all entities of one EntityStore.
+// Each component is its own packed array indexed by the same dense slot, so a
+// system walks only the arrays it reads and one pass covers every kind.
+enum AgentKind : uint8_t { AGENT_CAR, AGENT_BIKE, AGENT_PERSON, AGENT_CLOUD, AGENT_KIND_COUNT };
+
+struct Transform { float x,y; };
+
+struct Kinematics {
+    float vx;          // world units per 60 Hz tick, written by the behaviour systems
+    float speed;       // cruising speed
+    float targetSpeed;
+    int dir;           // 1 right, -1 left
+};
+
+struct RenderStyle {
+    float phase;  // walk cycle offset (people)
+    int size;     // cloud radius, 0 for the rest; also widens the wrap margin
+    float depth;  // cloud depth 0..1, picks its parallax layer
+};
+
+struct Behavior {
+    float goalX;   // people: where they are walking to
+    bool waiting;  // people: held at a crossing
 };
-std::vector<Building> buildings;
 
-void buildCity(){
+// Tuning shared by every entity of a kind.
+struct AgentKindInfo {
+    float accel, decel;        // per tick, toward targetSpeed
+    int retargetPerMille;      // chance per tick of a new target speed (0 = no speed control)
+    float minSpeed, maxSpeed;  // target speed range
+    bool stopsAtLights;
+    float wrapLo, wrapHi;      // leaving past one edge...
+    float enterHi, enterLo;    // ...re-enters at the other
+};
+
+const AgentKindInfo AGENT_KINDS[AGENT_KIND_COUNT] = {
+    /* car    */ {0.04f, 0.06f, 3, 0.5f, 3.0f, true,  -300, WORLD_W*2 + 300.0f, WORLD_W*2 + 300.0f, -300},
+    /* bike   */ {0.05f, 0.07f, 4, 0.8f, 4.0f, false, -300, WORLD_W*2 + 300.0f, WORLD_W*2 + 300.0f, -300},
+    /* person */ {0, 0, 0, 0, 0, false, -60, WORLD_W*2 + 60.0f, WORLD_W*2 + 40.0f, -40},
+    /* cloud  */ {0, 0, 0, 0, 0, false, -1e9f, (float)(WORLD_W*2), (float)(WORLD_W*2), 0},
+};
+
+// Clouds drift as whole parallax layers: a cloud's transform is its place in
+// the layer strip and the layer scrolls, wrapping every CLOUD_PERIOD units.
+const int CLOUD_LAYERS = 3;
+const float CLOUD_LAYER_DEPTH[CLOUD_LAYERS + 1] = {0.0f, 0.5f, 0.75f, 2.0f}; // layer l holds depth [l, l+1)
+const float CLOUD_LAYER_SPEED[CLOUD_LAYERS] = {0.14f, 0.22f, 0.32f};       // nearer layers drift faster
+const int CLOUD_MARGIN = 160;                                                // strip reaches this far past the world
+const float CLOUD_PERIOD = WORLD_W*2 + 2*CLOUD_MARGIN;
+
+int cloudLayer(float depth){
+    int l = 0;
+    while(l < CLOUD_LAYERS - 1 && depth >= CLOUD_LAYER_DEPTH[l + 1]) l++;
+    return l;
+}
+
+typedef uint32_t EntityId;
+
+// The components the renderer reads, all indexed by slot 0..size()-1. A
+// published frame copies only these (see SceneView).
+struct AgentArrays {
+    std::vector<AgentKind> kind;
+    std::vector<Transform> transform;
+    std::vector<Kinematics> kinematics;
+    std::vector<RenderStyle> style;
+    int kindCount[AGENT_KIND_COUNT] = {0, 0, 0, 0}; // kept by create/destroy
+
+    size_t size() const { return kind.size(); }
+};
+
+class EntityStore : public AgentArrays {
+public:
+    std::vector<Behavior> behavior; // sim-only, same slots as the render components
+
+    EntityId create(AgentKind k, const Transform &t, const Kinematics &m, const RenderStyle &rs, const Behavior &b){
+        EntityId id;
+        if(!freeIds.empty()){ id = freeIds.back(); freeIds.pop_back(); }
+        else { id = (EntityId)slotOf.size(); slotOf.push_back(0); }
+        slotOf[id] = (uint32_t)size();
+        ids.push_back(id);
+        kind.push_back(k); transform.push_back(t); kinematics.push_back(m); style.push_back(rs); behavior.push_back(b);
+        kindCount[k]++;
+        return id;
+    }
+
+    // swap-and-pop: the last entity moves into the hole, so the arrays stay packed
+    void destroy(EntityId id){
+        uint32_t slot = slotOf[id], last = (uint32_t)size() - 1;
+        kindCount[kind[slot]]--;
+        if(slot != last){
+            kind[slot] = kind[last]; transform[slot] = transform[last]; kinematics[slot] = kinematics[last];
+            style[slot] = style[last]; behavior[slot] = behavior[last];
+            ids[slot] = ids[last];
+            slotOf[ids[slot]] = slot;
+        }
+        kind.pop_back(); transform.pop_back(); kinematics.pop_back(); style.pop_back(); behavior.pop_back();
+        ids.pop_back();
+        freeIds.push_back(id);
+    }
+
+    void destroyKind(AgentKind k){
+        for(size_t i = size(); i-- > 0; ) if(kind[i] == k) destroy(ids[i]);
+    }
+
+    // the newest `count` of kind k; they sit at the back, so the walk stops early
+    void destroyKind(AgentKind k, int count){
+        for(size_t i = size(); i-- > 0 && count > 0; ) if(kind[i] == k){ destroy(ids[i]); count--; }
+    }
+
+private:
+    std::vector<EntityId> ids;     // slot -> id
+    std::vector<uint32_t> slotOf;  // id -> slot, valid while the id is live
+    std::vector<EntityId> freeIds;
+};
+
+// Every traffic light runs the same phase: cars go only on green, people
+// cross only while the cars have red.
+enum SignalPhase : uint8_t { SIGNAL_GREEN, SIGNAL_YELLOW, SIGNAL_RED };
+const float SIGNAL_GREEN_S = 5.0f, SIGNAL_YELLOW_S = 1.5f, SIGNAL_RED_S = 4.5f; // sim seconds
+
+SignalPhase signalPhaseAt(float simTime){
+    float t = fmodf(simTime, SIGNAL_GREEN_S + SIGNAL_YELLOW_S + SIGNAL_RED_S);
+    if(t < SIGNAL_GREEN_S) return SIGNAL_GREEN;
+    if(t < SIGNAL_GREEN_S + SIGNAL_YELLOW_S) return SIGNAL_YELLOW;
+    return SIGNAL_RED;
+}
+
+// Pedestrian flow field over the sidewalk, one FLOW_CELL-wide cell per entry
+// and one row per destination class (heading for the east or the west end).
+// An entry is the speed factor for a walker in that cell: 1 keeps walking, 0
+// holds at the curb of a closed crossing. It depends only on the lights, so
+// it is rebuilt when the phase changes and each person reads it with one
+// lookup. The same cells bin the crowd for spacing.
+enum PedestrianDest : uint8_t { DEST_EAST, DEST_WEST, DEST_COUNT };
+const int FLOW_CELL = 8;
+const int FLOW_MARGIN = 64; // people wrap at -60 / WORLD_W*2+60
+const int FLOW_CELLS = (WORLD_W*2 + 2*FLOW_MARGIN) / FLOW_CELL;
+
+struct PedestrianField {
+    std::vector<float> flow;     // flow[dest*FLOW_CELLS + cell]
+    std::vector<int> occupancy;  // people per cell, refilled every tick
+    int builtFor = -1;           // signal phase of flow, -1 forces a rebuild
+};
+
+int flowCell(float x){
+    return std::max(0, std::min(FLOW_CELLS - 1, (int)(x + FLOW_MARGIN) / FLOW_CELL));
+}
+
+// Everything the simulation advances. The render thread only ever sees
+// an immutable SceneView published from it (see the sim/render pipeline below).
+struct SceneState {
+    float simTime = 0.0f; // seconds
+    uint32_t frame = 0;   // sim ticks so far
+    Sun sun{0.9f};
+    bool dayMode = false; // toggled with 'd'
+    bool raining = true;
+    std::vector<Building> buildings;
+    uint32_t cityGeneration = 0;       // bumped whenever buildCity runs
+    std::vector<float> roofline;       // highest surface per world column, see buildRoofline()
+    std::vector<uint32_t> windowLit;   // one bit per window, one word per building row
+    TimerWheel windowEvents;
+    bool windowsDay = false;           // day/night density the windows are settling towards
+    RainField drops;
+    int dropTarget = 0;                // drops grows/shrinks towards this, see resizeRain()
+    std::vector<Splash> splashes;
+    EntityStore agents;                // cars, bikes, people and clouds
+    int peopleTarget = 0;              // people grow/shrink towards this, see resizePeople()
+    float cloudScroll[CLOUD_LAYERS] = {0.0f, 0.0f, 0.0f};
+    uint32_t cloudGeneration = 0;      // bumped whenever the cloud set changes
+    bool overcast = false;             // toggled with 'o'
+    std::vector<float> trafficLightsX; // simple traffic light point(s) for cars to stop
+    SignalPhase signal = SIGNAL_GREEN; // shared by all lights, see signalPhaseAt()
+    PedestrianField pedestrians;
+    float cameraX=0.0f, cameraZoom=1.0f, camTargetX=0.0f, camTargetZoom=1.0f;
+    bool cameraAuto = true;
+};
+
+// The part of SceneState the renderer reads. The sim thread publishes one per
+// tick (see publishScene), so it leaves out sim-only bookkeeping: the timer
+// wheel, roofline, pedestrian field, agent behaviours and id maps, and the
+// drops' collision flags.
+struct SceneView {
+    float simTime = 0.0f;
+    uint32_t frame = 0;
+    Sun sun{0.9f};
+    bool dayMode = false;
+    bool raining = true;
+    std::vector<Building> buildings;   // only recopied when cityGeneration changes
+    uint32_t cityGeneration = 0;
+    std::vector<uint32_t> windowLit;
+    RainField drops;                   // alive stays empty
+    int dropTarget = 0;
+    std::vector<Splash> splashes;
+    AgentArrays agents;
+    float cloudScroll[CLOUD_LAYERS] = {0.0f, 0.0f, 0.0f};
+    uint32_t cloudGeneration = 0;
+    std::vector<float> trafficLightsX;
+    SignalPhase signal = SIGNAL_GREEN;
+    float cameraX=0.0f, cameraZoom=1.0f;
+};
+
+// vectors keep their capacity in the view, so this does not allocate once warm
+void publishScene(SceneView &v, const SceneState &s){
+    v.simTime = s.simTime; v.frame = s.frame; v.sun = s.sun;
+    v.dayMode = s.dayMode; v.raining = s.raining;
+    if(v.cityGeneration != s.cityGeneration){ v.buildings = s.buildings; v.cityGeneration = s.cityGeneration; }
+    v.windowLit = s.windowLit;
+    v.drops.x = s.drops.x; v.drops.y = s.drops.y;
+    v.drops.vx = s.drops.vx; v.drops.vy = s.drops.vy; v.drops.len = s.drops.len;
+    v.dropTarget = s.dropTarget;
+    v.splashes = s.splashes;
+    v.agents = s.agents; // the AgentArrays part only
+    std::copy(s.cloudScroll, s.cloudScroll + CLOUD_LAYERS, v.cloudScroll);
+    v.cloudGeneration = s.cloudGeneration;
+    v.trafficLightsX = s.trafficLightsX;
+    v.signal = s.signal;
+    v.cameraX = s.cameraX; v.cameraZoom = s.cameraZoom;
+}
+
+// Column height map for rain collision: roofline[x + ROOF_MARGIN] is the top
+// of whatever stands at world column x (a roof, or GROUND_Y on the street).
+// Only rebuilt when the city changes, so a drop's collision test is one load.
+const int ROOF_MARGIN = 64; // drops wrap at -50 / WORLD_W*2+50
+void buildRoofline(SceneState &scene){
+    auto &roof = scene.roofline;
+    roof.assign(WORLD_W*2 + 2*ROOF_MARGIN, (float)GROUND_Y);
+    for(auto &b : scene.buildings){
+        for(int x = b.x; x < b.x + b.w; ++x) roof[x + ROOF_MARGIN] = std::max(roof[x + ROOF_MARGIN], (float)(b.y + b.h));
+    }
+}
+
+// ------------------ Window lights ------------------
+// Whether a window is lit is a fixed hash of (building, window) against the
+// building's density for the time of day, so every window has a stable state.
+// Changes come from the timer wheel: a day/night switch schedules a staggered
+// settle for just the windows that differ, and a slow trickle of flickers
+// toggles single windows and schedules them back.
+bool windowTarget(const Building &b, uint32_t building, int window, bool day){
+    uint32_t h = building * 0x9E3779B1u ^ (uint32_t)window * 0x85EBCA6Bu;
+    h ^= h >> 15; h *= 0x2C1B3C6Du; h ^= h >> 12;
+    float density = b.brightWindows ? (day ? 0.11f : 0.16f) : (day ? 0.0f : 0.055f);
+    return (h & 0xFFFF) < density * 65536.0f;
+}
+
+void setWindow(SceneState &scene, uint32_t building, int window, bool lit){
+    const Building &b = scene.buildings[building];
+    uint32_t &row = scene.windowLit[b.litRow + window / b.winCols];
+    uint32_t bit = 1u << (window % b.winCols);
+    row = lit ? (row | bit) : (row & ~bit);
+}
+
+bool windowIsLit(const SceneState &scene, uint32_t building, int window){
+    const Building &b = scene.buildings[building];
+    return (scene.windowLit[b.litRow + window / b.winCols] >> (window % b.winCols)) & 1u;
+}
+
+// A building row is one uint32_t and drawBuilding masks it with
+// (1u << winCols) - 1, so wider facades keep their first 31 columns.
+const int MAX_WINDOW_COLS = 31;
+
+void initWindows(SceneState &scene){
+    scene.windowsDay = isDaytime(scene.sun.angle);
+    scene.windowEvents.clear();
+    scene.windowLit.clear();
+    for(uint32_t i=0;i<scene.buildings.size();i++){
+        Building &b = scene.buildings[i];
+        b.winCols = std::min(MAX_WINDOW_COLS, b.w > 10 ? (b.w - 11) / 18 + 1 : 0);
+        b.winRows = b.h > 12 ? (b.h - 13) / 22 + 1 : 0;
+        b.litRow = (int)scene.windowLit.size();
+        scene.windowLit.resize(scene.windowLit.size() + b.winRows, 0u);
+        for(int w=0; w < b.winCols*b.winRows; w++) setWindow(scene, i, w, windowTarget(b, i, w, scene.windowsDay));
+    }
+}
+
+void updateWindows(SceneState &scene){
+    if(scene.buildings.empty()) return;
+    // dusk / dawn: move towards the new density over ~4 s
+    if(scene.dayMode != scene.windowsDay){
+        scene.windowsDay = scene.dayMode;
+        for(uint32_t i=0;i<scene.buildings.size();i++){
+            const Building &b = scene.buildings[i];
+            for(int w=0; w < b.winCols*b.winRows; w++){
+                if(windowIsLit(scene, i, w) != windowTarget(b, i, w, scene.windowsDay)) scene.windowEvents.schedule(rand()%240, i, w);
+            }
+        }
+    }
+    // occasional flicker: someone switches a light, and it settles back later
+    if(rand()%4 == 0){
+        uint32_t i = rand() % scene.buildings.size();
+        const Building &b = scene.buildings[i];
+        if(b.winCols*b.winRows > 0){
+            int w = rand() % (b.winCols*b.winRows);
+            setWindow(scene, i, w, !windowIsLit(scene, i, w));
+            scene.windowEvents.schedule(120 + rand()%1080, i, w);
+        }
+    }
+    scene.windowEvents.advance([&scene](const WindowEvent &e){
+        setWindow(scene, e.building, e.window, windowTarget(scene.buildings[e.building], e.building, e.window, scene.windowsDay));
+    });
+}
+
+void buildCity(SceneState &scene){
+    auto &buildings = scene.buildings;
     buildings.clear();
     int x = 0;
-    while(x < WIN_W*2){
+    while(x < WORLD_W*2){
         int w = 70 + (rand()%140);
         int h = 160 + (rand()%320);
-        if(x + w > WIN_W*2) w = WIN_W*2 - x;
+        if(x + w > WORLD_W*2) w = WORLD_W*2 - x;
         Building b; b.x=x; b.y=GROUND_Y; b.w=w; b.h=h;
         b.baseR = 0.12f + (rand()%6)*0.06f;
         b.baseG = 0.12f + (rand()%5)*0.05f;
@@ -119,125 +518,275 @@ void buildCity(){
         buildings.push_back(b);
         x += w + 12;
     }
+    scene.cityGeneration++;
+    buildRoofline(scene);
+    initWindows(scene);
 }
 
 // shading helper: simulate simple lambert diffuse using sun direction
-void applyDirectionalTint(float &r,float &g,float &b, float nx, float ny, float nz){
+void applyDirectionalTint(float sunAngle, float &r,float &g,float &b, float nx, float ny, float nz){
     // sun direction from sun.angle (y axis range)
-    float sx = cosf(sun.angle);
-    float sy = sinf(sun.angle);
+    float sx = cosf(sunAngle);
+    float sy = sinf(sunAngle);
     // normal dot light (assume light comes from above and slightly tilt)
     float dot = clampf(nx*sx + ny*sy + nz*0.6f, 0.0f, 1.0f);
     // when night, lower base and use bluish ambient
-    float amb = dayMode ? 0.25f : 0.08f;
+    bool day = isDaytime(sunAngle);
+    float amb = day ? 0.25f : 0.08f;
     float diffuse = amb + (0.75f * dot);
     // apply tint
     r *= diffuse; g *= diffuse; b *= diffuse;
     // color grade slight teal shadows / warm highlights (simple)
-    if(!dayMode){
+    if(!day){
         r *= 0.95f; g *= 1.05f; b *= 1.12f;
     }
 }
 
+// ------------------ Time-of-day lookup tables ------------------
+// Sky, sun position and wall lighting depend on sun.angle alone, which crawls
+// (0.02 rad per simulated second), so the whole cycle is baked once at startup
+// and a frame's lighting is a table lookup. The sun's x moves up to
+// WORLD_W*0.9 = 1152 units per radian, so 8192 steps keep its jump between
+// entries at 1152 * 2pi / 8192 = 0.88 units, under one world unit.
+const int LIGHT_STEPS = 8192;
+const int SKY_BANDS = 8;
+
+struct LightingEntry {
+    float sky[SKY_BANDS][3]; // gradient band colors, bottom to top
+    float sunX, sunY;        // sun/moon center
+    float tint[3];           // diffuse * color grade for a front-facing wall
+};
+
+std::vector<LightingEntry> lightingTable;
+
+int lightIndex(float sunAngle){
+    float t = fmodf(sunAngle / (float)(2*PI), 1.0f);
+    if(t < 0.0f) t += 1.0f;
+    if(!(t < 1.0f)) t = 0.0f; // NaN, or a negative sliver that rounded up to 1
+    return std::min((int)(t * LIGHT_STEPS), LIGHT_STEPS - 1);
+}
+
+void bakeLighting(){
+    lightingTable.resize(LIGHT_STEPS);
+    for(int k=0;k<LIGHT_STEPS;k++){
+        float angle = (float)(2*PI) * k / LIGHT_STEPS;
+        LightingEntry &e = lightingTable[k];
+        // time-of-day interpolation
+        float dayPhase = (sinf(angle)+1.0f)/2.0f; // 0..1
+        for(int i=0;i<SKY_BANDS;i++){
+            float t = i/(float)SKY_BANDS;
+            // base colors shift with dayPhase
+            e.sky[i][0] = 0.02f + t*(0.06f + 0.15f*dayPhase);
+            e.sky[i][1] = 0.04f + t*(0.06f + 0.08f*dayPhase);
+            e.sky[i][2] = 0.08f + t*(0.08f + 0.06f*dayPhase);
+        }
+        e.sunX = WORLD_W*1.8f * ((cosf(angle)*0.5f)+0.5f); // sweep across sky
+        e.sunY = WORLD_H - 200 + sinf(angle)*60.0f;
+        e.tint[0] = e.tint[1] = e.tint[2] = 1.0f;
+        applyDirectionalTint(angle, e.tint[0], e.tint[1], e.tint[2], 0.0f, 0.0f, 1.0f);
+    }
+}
+
+const LightingEntry &lightingAt(float sunAngle){ return lightingTable[lightIndex(sunAngle)]; }
+
+// Render-side cache of every building's lit wall color, refreshed only when
+// the quantized sun angle moves to another table entry or the city is rebuilt.
+std::vector<float> buildingTints; // r,g,b per building
+int buildingTintIndex = -1;
+uint32_t buildingTintCity = 0;    // cityGeneration the cache was built for
+
+void refreshBuildingTints(const SceneView &scene){
+    int idx = lightIndex(scene.sun.angle);
+    if(idx == buildingTintIndex && scene.cityGeneration == buildingTintCity) return;
+    const float *tint = lightingTable[idx].tint;
+    buildingTints.resize(scene.buildings.size()*3);
+    for(size_t i=0;i<scene.buildings.size();i++){
+        const Building &b = scene.buildings[i];
+        buildingTints[3*i] = b.baseR * tint[0];
+        buildingTints[3*i+1] = b.baseG * tint[1];
+        buildingTints[3*i+2] = b.baseB * tint[2];
+    }
+    buildingTintIndex = idx;
+    buildingTintCity = scene.cityGeneration;
+}
+
 // draw building with simple shading + window lights at night
-void drawBuilding(const Building &b, bool mirrored=false, float alpha=1.0f){
-    if(mirrored){
-        glColor4f(b.baseR*0.5f, b.baseG*0.5f, b.baseB*0.5f, alpha*0.35f);
-        drawFilledRect(b.x, GROUND_Y - b.h, b.w, b.h);
-        return;
-    }
-    // compute approximate normal tilt for building front (face normal = (0,0,1))
-    float r = b.baseR, g = b.baseG, bl = b.baseB;
-    applyDirectionalTint(r,g,bl, 0.0f, 0.0f, 1.0f);
-    glColor3f(r,g,bl);
+void drawBuilding(const SceneView &scene, const Building &b, const float *tint){
+    // front face lit through the cached tint (face normal = (0,0,1))
+    glColor3fv(tint);
     drawFilledRect(b.x, b.y, b.w, b.h);
 
-    // windows
+    // windows: scan each row's bitset, unlit windows first, then lit ones
+    const uint32_t *rows = scene.windowLit.data() + b.litRow;
+    const uint32_t mask = (1u << b.winCols) - 1;
     glBegin(GL_POINTS);
-    for(int wy=12; wy < b.h; wy += 22){
-        for(int wx=10; wx < b.w; wx += 18){
-            bool lit = b.brightWindows && (rand()%9==0);
-            if(!dayMode) lit = lit || (rand()%18==0); // more lights at night
-            float wr = lit ? 1.0f : 0.45f;
-            float wg = lit ? 0.95f : 0.45f;
-            float wb = lit ? 0.7f : 0.35f;
-            glColor3f(wr, wg, wb);
-            putPixel(b.x + wx, b.y + wy);
-        }
+    glColor3f(0.45f, 0.45f, 0.35f);
+    for(int r=0; r<b.winRows; r++){
+        for(uint32_t bits = ~rows[r] & mask; bits; bits &= bits - 1) putPixel(b.x + 10 + 18*__builtin_ctz(bits), b.y + 12 + 22*r);
+    }
+    glColor3f(1.0f, 0.95f, 0.7f);
+    for(int r=0; r<b.winRows; r++){
+        for(uint32_t bits = rows[r]; bits; bits &= bits - 1) putPixel(b.x + 10 + 18*__builtin_ctz(bits), b.y + 12 + 22*r);
     }
     glEnd();
 }
 
 // ------------------ Clouds ------------------
-struct Cloud { float x,y; float speed; int size; float depth; };
-std::vector<Cloud> clouds;
-void initClouds(){
-    clouds.clear();
-    for(int i=0;i<14;i++){
-        Cloud c; c.x = rand()%(WIN_W*2); c.y = WIN_H - 120 - (rand()%220);
-        c.speed = 0.06f + (rand()%12)*0.02f; c.size = 50 + (rand()%80); c.depth = 0.2f + (rand()%80)/100.0f;
-        clouds.push_back(c);
-    }
-}
-void drawCloud(const Cloud &c){
-    float base = 0.6f * c.depth;
+void initClouds(SceneState &scene, int count=14){
+    auto &agents = scene.agents;
+    agents.destroyKind(AGENT_CLOUD);
+    for(int i=0;i<count;i++){
+        float x = rand()%(WORLD_W*2), y = WORLD_H - 120 - (rand()%220);
+        int size = 50 + (rand()%80); float depth = 0.2f + (rand()%80)/100.0f;
+        agents.create(AGENT_CLOUD, {x,y}, {0.0f, 0.0f, 0.0f, 1}, {0.0f, size, depth}, {0.0f, false});
+    }
+    scene.cloudGeneration++;
+}
+
+void updateCloudLayers(SceneState &scene, float dt){
+    for(int l=0;l<CLOUD_LAYERS;l++){
+        scene.cloudScroll[l] = fmodf(scene.cloudScroll[l] + CLOUD_LAYER_SPEED[l] * dt*60.0f, CLOUD_PERIOD);
+    }
+}
+
+// Cloud impostors: every layer is one repeating alpha strip, CLOUD_PERIOD world
+// units wide. A cloud's five puffs are rasterized into its layer's strip once,
+// when the cloud set changes; after that a layer is a single textured quad,
+// whatever the number or size of its clouds.
+const int CLOUD_TEX_W = 2048, CLOUD_TEX_H = 512;
+const float CLOUD_TEXEL = CLOUD_TEX_W / CLOUD_PERIOD; // texels per world unit
+const int CLOUD_BAND_Y = WORLD_H - 440;                // world y of the strip's bottom row
+GLuint cloudTex[CLOUD_LAYERS] = {0, 0, 0};
+uint32_t cloudTexGeneration = 0;
+std::vector<float> cloudCoverage; // bake scratch, one alpha per texel
+std::vector<uint8_t> cloudTexels;
+
+void bakeCloudLayers(const SceneView &scene){
+    if(!cloudTex[0]) glGenTextures(CLOUD_LAYERS, cloudTex);
+    const AgentArrays &agents = scene.agents;
+    cloudTexels.resize(CLOUD_TEX_W * CLOUD_TEX_H);
+    for(int l=0;l<CLOUD_LAYERS;l++){
+        cloudCoverage.assign(CLOUD_TEX_W * CLOUD_TEX_H, 0.0f);
+        for(size_t i=0;i<agents.size();i++){
+            if(agents.kind[i] != AGENT_CLOUD) continue;
+            const Transform &t = agents.transform[i];
+            const RenderStyle &c = agents.style[i];
+            if(cloudLayer(c.depth) != l) continue;
+            float base = 0.6f * c.depth;
+            for(int k=0;k<5;k++){
+                float ox = (k-2)*(c.size*0.18f);
+                float oy = (k%2==0?6.0f:-6.0f);
+                float r = c.size*0.42f + k*4;
+                float a = base*(1.0f - k*0.08f);
+                // same result as blending the puffs one after another in the frame
+                rasterFilledCircle((int)((t.x + ox + CLOUD_MARGIN) * CLOUD_TEXEL), (int)((t.y + oy - CLOUD_BAND_Y) * CLOUD_TEXEL),
+                                   (int)(r * CLOUD_TEXEL), [a](int x, int y){
+                    if((unsigned)y >= (unsigned)CLOUD_TEX_H) return;
+                    float &cov = cloudCoverage[y*CLOUD_TEX_W + ((x % CLOUD_TEX_W) + CLOUD_TEX_W) % CLOUD_TEX_W];
+                    cov += a * (1.0f - cov);
+                });
+            }
+        }
+        for(size_t i=0;i<cloudTexels.size();i++) cloudTexels[i] = (uint8_t)(cloudCoverage[i] * 255.0f + 0.5f);
+        glBindTexture(GL_TEXTURE_2D, cloudTex[l]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, CLOUD_TEX_W, CLOUD_TEX_H, 0, GL_ALPHA, GL_UNSIGNED_BYTE, cloudTexels.data());
+    }
+    cloudTexGeneration = scene.cloudGeneration;
+}
+
+// back pass: layers behind the buildings; front pass: the rest
+void drawClouds(const SceneView &scene, bool front){
+    if(!cloudTex[0] || cloudTexGeneration != scene.cloudGeneration) bakeCloudLayers(scene);
+    glEnable(GL_TEXTURE_2D);
     glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    for(int k=0;k<5;k++){
-        float ox = (k-2)*(c.size*0.18f);
-        float oy = (k%2==0?6.0f:-6.0f);
-        int r = int(c.size*0.42f + k*4);
-        glColor4f(0.9f,0.92f,0.94f, base*(1.0f - k*0.08f));
-        drawFilledCircle((int)(c.x + ox),(int)(c.y + oy), r);
+    glColor4f(0.9f,0.92f,0.94f,1.0f);
+    float x0 = -CLOUD_MARGIN, x1 = x0 + CLOUD_PERIOD;
+    float y0 = CLOUD_BAND_Y, y1 = y0 + CLOUD_TEX_H / CLOUD_TEXEL;
+    for(int l=0;l<CLOUD_LAYERS;l++){
+        if((CLOUD_LAYER_DEPTH[l] >= 0.5f) != front) continue;
+        float u0 = -scene.cloudScroll[l] / CLOUD_PERIOD, u1 = u0 + 1.0f;
+        glBindTexture(GL_TEXTURE_2D, cloudTex[l]);
+        glBegin(GL_QUADS);
+        glTexCoord2f(u0,0); glVertex2f(x0,y0);
+        glTexCoord2f(u1,0); glVertex2f(x1,y0);
+        glTexCoord2f(u1,1); glVertex2f(x1,y1);
+        glTexCoord2f(u0,1); glVertex2f(x0,y1);
+        glEnd();
     }
     glDisable(GL_BLEND);
-}
-void updateClouds(float dt){
-    for(auto &c:clouds){ c.x += c.speed * (1.0f + c.depth*0.6f) * dt*60.0f; if(c.x - c.size > WIN_W*2) c.x = -c.size; }
+    glDisable(GL_TEXTURE_2D);
 }
 
 // ------------------ Rain physics ------------------
-struct Drop {
-    float x,y;
-    float vx, vy;
-    float len;
-    bool alive;
-};
-std::vector<Drop> drops;
 
-struct Splash {
-    float x,y;
-    float radius;
-    float life;
-};
-std::vector<Splash> splashes;
 
-void initDrops(int count){
+void spawnDrop(RainField &drops){
+    float x = rand()%(WORLD_W*2), y = WORLD_H - (rand()%WORLD_H);
+    float vx = -2.0f + (rand()%5), vy = -7.0f - (rand()%8), len = 8 + (rand()%12);
+    drops.push(x, y, vx, vy, len);
+}
+
+void initDrops(SceneState &scene, int count){
+    auto &drops = scene.drops;
     drops.clear(); drops.reserve(count);
-    for(int i=0;i<count;i++){
-        Drop d; d.x = rand()%(WIN_W*2); d.y = WIN_H - (rand()%WIN_H);
-        d.vx = -2.0f + (rand()%5); d.vy = -7.0f - (rand()%8); d.len = 8 + (rand()%12); d.alive=true;
-        drops.push_back(d);
+    for(int i=0;i<count;i++) spawnDrop(drops);
+    scene.dropTarget = count;
+}
+
+// Live pool resizes (control endpoint) move at most DROP_RESIZE_STEP drops a
+// tick, so going from 900 to 500k drops never stalls a single frame.
+const int DROP_RESIZE_STEP = 4000;
+void resizeRain(SceneState &scene){
+    RainField &drops = scene.drops;
+    int n = (int)drops.size();
+    if(n < scene.dropTarget){
+        for(int i = std::min(DROP_RESIZE_STEP, scene.dropTarget - n); i > 0; --i) spawnDrop(drops);
+    } else if(n > scene.dropTarget){
+        drops.truncate(std::max(scene.dropTarget, n - DROP_RESIZE_STEP));
     }
 }
 
-void updateRain(float dt){
-    for(auto &d : drops){
-        d.x += d.vx * dt * 60.0f;
-        d.y += d.vy * dt * 60.0f;
+// pass 1 of updateRain: integrate and test every drop against the roofline.
+// Branch-free, no RNG and no aliasing, so the compiler can vectorize it.
+void collideRain(float *__restrict x, float *__restrict y, const float *__restrict vx, const float *__restrict vy,
+                 uint8_t *__restrict alive, const float *__restrict roof, int lastCol, float step, size_t n){
+    for(size_t i=0;i<n;i++){
+        x[i] += vx[i] * step;
+        y[i] += vy[i] * step;
+        int col = std::min(std::max((int)x[i] + ROOF_MARGIN, 0), lastCol);
+        alive[i] = y[i] >= roof[col];
+    }
+}
+
+void updateRain(SceneState &scene, float dt){
+    auto &splashes = scene.splashes;
+    RainField &d = scene.drops;
+    const float *roof = scene.roofline.data();
+    const int lastCol = (int)scene.roofline.size() - 1;
+    collideRain(d.x.data(), d.y.data(), d.vx.data(), d.vy.data(), d.alive.data(), roof, lastCol, dt * 60.0f, d.size());
+    // pass 2: wind, splashes and respawn
+    for(size_t i=0;i<d.size();i++){
         // wind wobble
-        d.vx += ( (rand()%100)-50 ) * 0.0003f;
-        if(d.y < GROUND_Y){
-            // spawn splash
+        d.vx[i] += ( (rand()%100)-50 ) * 0.0003f;
+        if(!d.alive[i]){
+            // spawn splash: street splashes spread over the lane, roof splashes sit on the roof
             if((int)splashes.size() < MAX_SPLASHES && (rand()%3==0)){
-                Splash s; s.x = d.x; s.y = GROUND_Y - 18 + (rand()%12); s.radius = 1.0f; s.life = 1.0f;
+                float top = roof[std::min(std::max((int)d.x[i] + ROOF_MARGIN, 0), lastCol)];
+                Splash s; s.x = d.x[i]; s.radius = 1.0f; s.life = 1.0f;
+                s.y = (top > GROUND_Y) ? top + (rand()%3) : GROUND_Y - 18 + (rand()%12);
                 splashes.push_back(s);
             }
             // respawn
-            d.x = rand()%(WIN_W*2); d.y = WIN_H - (rand()%150);
-            d.vx = -2.0f + (rand()%5); d.vy = -7.0f - (rand()%6); d.len = 8 + (rand()%10);
+            d.x[i] = rand()%(WORLD_W*2); d.y[i] = WORLD_H - (rand()%150);
+            d.vx[i] = -2.0f + (rand()%5); d.vy[i] = -7.0f - (rand()%6); d.len[i] = 8 + (rand()%10); d.alive[i] = 1;
         }
-        if(d.x < -50) d.x = WIN_W*2 + 50;
-        if(d.x > WIN_W*2 + 50) d.x = -50;
+        if(d.x[i] < -50) d.x[i] = WORLD_W*2 + 50;
+        if(d.x[i] > WORLD_W*2 + 50) d.x[i] = -50;
     }
     // update splashes
     for(auto &s : splashes){
@@ -247,18 +796,19 @@ void updateRain(float dt){
     splashes.erase(std::remove_if(splashes.begin(), splashes.end(), [](const Splash &s){ return s.life <= 0.0f; }), splashes.end());
 }
 
-void drawRain(){
+void drawRain(const SceneView &scene){
     glColor3f(0.78f,0.84f,1.0f);
-    for(auto &d : drops){
-        int x2 = (int)(d.x + d.vx * (d.len / fabs(d.vy)));
-        int y2 = (int)(d.y + d.vy * (d.len / fabs(d.vy)));
-        drawLineDDA((int)d.x, (int)d.y, x2, y2);
+    const RainField &d = scene.drops;
+    for(size_t i=0;i<d.size();i++){
+        int x2 = (int)(d.x[i] + d.vx[i] * (d.len[i] / fabs(d.vy[i])));
+        int y2 = (int)(d.y[i] + d.vy[i] * (d.len[i] / fabs(d.vy[i])));
+        drawLineDDA((int)d.x[i], (int)d.y[i], x2, y2);
     }
 }
 
-void drawSplashes(){
+void drawSplashes(const SceneView &scene){
     glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    for(auto &s : splashes){
+    for(auto &s : scene.splashes){
         float a = s.life * 0.6f;
         glColor4f(0.6f,0.82f,1.0f, a);
         int steps = 80;
@@ -275,228 +825,219 @@ void drawSplashes(){
 }
 
 // ------------------ Vehicles with smoother physics ------------------
-struct Vehicle {
-    float x,y;
-    float speed;
-    int dir; // 1 right, -1 left
-    float targetSpeed;
-};
-std::vector<Vehicle> cars;
-std::vector<Vehicle> bikes;
 
-void spawnVehicles(){
-    cars.clear(); bikes.clear();
+void spawnVehicles(SceneState &scene){
+    auto &agents = scene.agents;
+    agents.destroyKind(AGENT_CAR); agents.destroyKind(AGENT_BIKE);
     for(int i=0;i<10;i++){
-        Vehicle v; v.x = rand()%(WIN_W*2); v.y = 72; v.speed = 1.6f + (rand()%30)/20.0f; v.dir = (rand()%2)?1:-1; v.targetSpeed = v.speed;
-        cars.push_back(v);
+        float x = rand()%(WORLD_W*2), speed = 1.6f + (rand()%30)/20.0f; int dir = (rand()%2)?1:-1;
+        agents.create(AGENT_CAR, {x, 72.0f}, {speed*dir, speed, speed, dir}, {0.0f, 0, 0.0f}, {0.0f, false});
     }
     for(int i=0;i<6;i++){
-        Vehicle v; v.x = rand()%(WIN_W*2); v.y = 72 + (rand()%8); v.speed = 2.0f + (rand()%30)/20.0f; v.dir = (rand()%2)?1:-1; v.targetSpeed = v.speed;
-        bikes.push_back(v);
+        float x = rand()%(WORLD_W*2), y = 72 + (rand()%8), speed = 2.0f + (rand()%30)/20.0f; int dir = (rand()%2)?1:-1;
+        agents.create(AGENT_BIKE, {x, y}, {speed*dir, speed, speed, dir}, {0.0f, 0, 0.0f}, {0.0f, false});
     }
 }
 
-// simple traffic light point(s) for cars to stop
-std::vector<float> trafficLightsX;
-
-void initTraffic(){
+void initTraffic(SceneState &scene){
+    auto &trafficLightsX = scene.trafficLightsX;
     trafficLightsX.clear();
-    trafficLightsX.push_back(WIN_W*0.5f);
-    trafficLightsX.push_back(WIN_W*1.1f);
+    trafficLightsX.push_back(WORLD_W*0.5f);
+    trafficLightsX.push_back(WORLD_W*1.1f);
+    scene.pedestrians.builtFor = -1;
 }
 
-void updateVehicles(float dt){
-    // basic behavior: accelerate towards targetSpeed; random slowdowns
-    for(auto &v : cars){
-        if(rand()%1000 < 3) v.targetSpeed = clampf(0.5f + (rand()%40)/20.0f, 0.5f, 3.0f);
+// speed control system: every kind with a speed range accelerates towards its
+// target speed, with random slowdowns, and stops at red lights if it obeys them
+void updateAgentSpeeds(SceneState &scene, float dt){
+    auto &agents = scene.agents;
+    for(size_t i=0;i<agents.size();i++){
+        const AgentKindInfo &info = AGENT_KINDS[agents.kind[i]];
+        if(info.retargetPerMille == 0) continue;
+        Kinematics &v = agents.kinematics[i];
+        if(rand()%1000 < info.retargetPerMille) v.targetSpeed = clampf(info.minSpeed + (rand()%40)/20.0f, info.minSpeed, info.maxSpeed);
         // check lights / stopping
-        for(auto tx : trafficLightsX){
-            float approach = (v.dir==1) ? (tx - v.x) : (v.x - tx);
-            if(approach > 0 && approach < 120){
-                // if global sun.angle indicates red (simulate) then stop (for demo)
-                if( (int)(sun.angle*10) % 17 < 6 ) { // opportunistic red phases
-                    v.targetSpeed = 0.0f;
+        if(info.stopsAtLights){
+            float x = agents.transform[i].x;
+            for(auto tx : scene.trafficLightsX){
+                float approach = (v.dir==1) ? (tx - x) : (x - tx);
+                if(approach > 0 && approach < 120){
+                    if(scene.signal != SIGNAL_GREEN) v.targetSpeed = 0.0f;
+                    else if(v.targetSpeed == 0.0f) v.targetSpeed = clampf(info.minSpeed + (rand()%40)/20.0f, info.minSpeed, info.maxSpeed); // pull away on green
                 }
             }
         }
         // smooth accel / decel
-        if(v.speed < v.targetSpeed) v.speed = std::min(v.targetSpeed, v.speed + 0.04f * dt * 60.0f);
-        else v.speed = std::max(v.targetSpeed, v.speed - 0.06f * dt * 60.0f);
-        v.x += v.speed * v.dir * dt * 60.0f;
-        if(v.x < -300) v.x = WIN_W*2 + 300;
-        if(v.x > WIN_W*2 + 300) v.x = -300;
+        if(v.speed < v.targetSpeed) v.speed = std::min(v.targetSpeed, v.speed + info.accel * dt * 60.0f);
+        else v.speed = std::max(v.targetSpeed, v.speed - info.decel * dt * 60.0f);
+        v.vx = v.speed * v.dir;
     }
-    for(auto &v : bikes){
-        if(rand()%1000 < 4) v.targetSpeed = clampf(0.8f + (rand()%40)/20.0f, 0.8f, 4.0f);
-        if(v.speed < v.targetSpeed) v.speed = std::min(v.targetSpeed, v.speed + 0.05f * dt * 60.0f);
-        else v.speed = std::max(v.targetSpeed, v.speed - 0.07f * dt * 60.0f);
-        v.x += v.speed * v.dir * dt * 60.0f;
-        if(v.x < -300) v.x = WIN_W*2 + 300;
-        if(v.x > WIN_W*2 + 300) v.x = -300;
+}
+
+// movement system: one pass over every agent, then wrap around the world
+void moveAgents(SceneState &scene, float dt){
+    auto &agents = scene.agents;
+    for(size_t i=0;i<agents.size();i++){
+        const AgentKindInfo &info = AGENT_KINDS[agents.kind[i]];
+        Transform &t = agents.transform[i];
+        float ext = (float)agents.style[i].size;
+        t.x += agents.kinematics[i].vx * dt * 60.0f;
+        if(t.x + ext < info.wrapLo) t.x = info.enterHi + ext;
+        if(t.x - ext > info.wrapHi) t.x = info.enterLo - ext;
     }
 }
 
-void drawVehicle(const Vehicle &v){
+void drawVehicle(const Transform &t, const Kinematics &v){
     // motion trail (cinematic)
     if(cinematic){
         glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         for(int i=1;i<=5;i++){
             float a = 0.08f*(1.0f - i*0.12f);
             float dx = -v.dir * i * (v.speed*6.0f);
-            drawRectAlpha((int)(v.x + dx), (int)(v.y+8), 18, 6, 0.9f, 0.3f, 0.25f, a);
+            drawRectAlpha((int)(t.x + dx), (int)(t.y+8), 18, 6, 0.9f, 0.3f, 0.25f, a);
         }
         glDisable(GL_BLEND);
     }
     // body
     glColor3f(0.92f,0.24f,0.22f);
-    drawFilledRect((int)v.x, (int)v.y, 80, 26);
-    // wheels
+    drawFilledRect((int)t.x, (int)t.y, 80, 26);
+    // wheels (headlight cones come from the light pass)
     glColor3f(0.08f,0.08f,0.08f);
-    drawFilledCircle((int)(v.x+16),(int)(v.y-6),8);
-    drawFilledCircle((int)(v.x+64),(int)(v.y-6),8);
-    // headlight cones
-    if(v.dir==1) {
-        // additive cone
-        glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-        for(int i=0;i<8;i++){
-            float a = 0.08f * (1.0f - i/8.0f);
-            drawRectAlpha((int)(v.x+80 + i*6), (int)(v.y+4), 36, 18 + i*2, 1.0f,0.98f,0.8f, a);
-        }
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); glDisable(GL_BLEND);
-    } else {
-        glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-        for(int i=0;i<8;i++){
-            float a = 0.08f * (1.0f - i/8.0f);
-            drawRectAlpha((int)(v.x - 36 - i*6), (int)(v.y+4), 36, 18 + i*2, 1.0f,0.98f,0.8f, a);
-        }
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); glDisable(GL_BLEND);
-    }
+    drawFilledCircle((int)(t.x+16),(int)(t.y-6),8);
+    drawFilledCircle((int)(t.x+64),(int)(t.y-6),8);
 }
 
 // ------------------ Pedestrians + pathfinding-ish behavior ------------------
-struct Person {
-    float x,y;
-    int dir;
-    float speed;
-    float phase;
-    bool waiting;
-    float goalX;
-};
-std::vector<Person> people;
-
-void spawnPeople(int n=16){
-    people.clear();
-    for(int i=0;i<n;i++){
-        Person p; p.x = rand()%(WIN_W*2); p.y = GROUND_Y + 12 + (rand()%6);
-        p.dir = (rand()%2)?1:-1; p.speed = 0.35f + (rand()%8)*0.03f; p.phase = (rand()%100)/20.0f; p.waiting=false;
-        p.goalX = p.x + ( (rand()%2)? 120 : -120 );
-        people.push_back(p);
-    }
-}
-
-void updatePeople(float dt){
-    for(auto &p : people){
-        // simple local repulsion to avoid overlap
-        float push = 0.0f;
-        for(auto &o : people){
-            if(&o==&p) continue;
-            float dx = o.x - p.x;
-            if(fabs(dx) < 14.0f){
-                push += (dx>0? -0.02f : 0.02f);
-            }
-        }
-        // crosswalk behaviour: if near traffic light and not safe, wait
-        bool nearLight = false, canCross = true;
-        for(auto tx : trafficLightsX){
-            float d = fabs(p.x - tx);
-            if(d < 60){ nearLight = true; if(rand()%17 < 10) canCross=false; } // simplified random gating for realism
-        }
-        if(nearLight && !canCross) { p.waiting = true; /* don't move */ }
-        else {
-            p.waiting = false;
-            // move toward goal (if reached, pick a new goal)
-            float dirSign = (p.goalX > p.x) ? 1.0f : -1.0f;
-            p.x += (p.speed + push) * dirSign * dt * 60.0f;
-            if(fabs(p.goalX - p.x) < 8.0f){ p.goalX = p.x + ( (rand()%2)? 90 : -90 ); }
+
+void spawnPerson(EntityStore &agents){
+    float x = rand()%(WORLD_W*2), y = GROUND_Y + 12 + (rand()%6);
+    int dir = (rand()%2)?1:-1; float speed = 0.35f + (rand()%8)*0.03f; float phase = (rand()%100)/20.0f;
+    float goalX = x + ( (rand()%2)? 120 : -120 );
+    agents.create(AGENT_PERSON, {x, y}, {0.0f, speed, speed, dir}, {phase, 0, 0.0f}, {goalX, false});
+}
+
+void spawnPeople(SceneState &scene, int n=16){
+    scene.agents.destroyKind(AGENT_PERSON);
+    for(int i=0;i<n;i++) spawnPerson(scene.agents);
+    scene.peopleTarget = n;
+}
+
+// Like resizeRain: a new crowd size from the control endpoint is reached
+// PEOPLE_RESIZE_STEP people a tick, never in one stall.
+const int PEOPLE_RESIZE_STEP = 2000;
+void resizePeople(SceneState &scene){
+    EntityStore &agents = scene.agents;
+    int n = agents.kindCount[AGENT_PERSON];
+    if(n < scene.peopleTarget){
+        for(int i = std::min(PEOPLE_RESIZE_STEP, scene.peopleTarget - n); i > 0; --i) spawnPerson(agents);
+    } else if(n > scene.peopleTarget){
+        agents.destroyKind(AGENT_PERSON, std::min(PEOPLE_RESIZE_STEP, n - scene.peopleTarget));
+    }
+}
+
+const float CROSSWALK_HALF = 40.0f; // a crossing spans light x +- this
+const float CURB_QUEUE = 16.0f;     // hold band in front of the curb
+
+void buildPedestrianField(SceneState &scene){
+    PedestrianField &field = scene.pedestrians;
+    field.flow.assign(DEST_COUNT*FLOW_CELLS, 1.0f);
+    field.builtFor = scene.signal;
+    if(scene.signal == SIGNAL_RED) return; // walk phase: every crossing is open
+    for(auto tx : scene.trafficLightsX){
+        // eastbound people queue west of the crossing, westbound east of it;
+        // anyone already on the crossing keeps walking
+        for(int c = flowCell(tx - CROSSWALK_HALF - CURB_QUEUE); c < flowCell(tx - CROSSWALK_HALF); ++c)
+            field.flow[DEST_EAST*FLOW_CELLS + c] = 0.0f;
+        for(int c = flowCell(tx + CROSSWALK_HALF) + 1; c <= flowCell(tx + CROSSWALK_HALF + CURB_QUEUE); ++c)
+            field.flow[DEST_WEST*FLOW_CELLS + c] = 0.0f;
+    }
+}
+
+// pedestrian system: decides each person's velocity, moveAgents applies it
+void updatePeople(SceneState &scene, float dt){
+    auto &agents = scene.agents;
+    PedestrianField &field = scene.pedestrians;
+    if(field.builtFor != scene.signal) buildPedestrianField(scene);
+    field.occupancy.assign(FLOW_CELLS, 0);
+    for(size_t i=0;i<agents.size();i++){
+        if(agents.kind[i] == AGENT_PERSON) field.occupancy[flowCell(agents.transform[i].x)]++;
+    }
+    for(size_t i=0;i<agents.size();i++){
+        if(agents.kind[i] != AGENT_PERSON) continue;
+        float x = agents.transform[i].x;
+        Behavior &p = agents.behavior[i];
+        // goal reached: pick a new one
+        if(fabs(p.goalX - x) < 8.0f){ p.goalX = x + ( (rand()%2)? 90 : -90 ); }
+        // local repulsion: people in the two cells either side push away
+        int c = flowCell(x), left = 0, right = 0;
+        for(int k=1;k<=2;k++){
+            if(c-k >= 0) left += field.occupancy[c-k];
+            if(c+k < FLOW_CELLS) right += field.occupancy[c+k];
         }
-        // wrap
-        if(p.x < -60) p.x = WIN_W*2 + 40;
-        if(p.x > WIN_W*2 + 60) p.x = -40;
+        float push = clampf(0.02f * (left - right), -0.2f, 0.2f);
+        // follow the field (a factor of 0 means wait at the crossing)
+        int dest = (p.goalX > x) ? DEST_EAST : DEST_WEST;
+        float flow = field.flow[dest*FLOW_CELLS + c];
+        p.waiting = flow == 0.0f;
+        float dirSign = (dest == DEST_EAST) ? 1.0f : -1.0f;
+        agents.kinematics[i].vx = (agents.kinematics[i].speed + push) * dirSign * flow;
     }
 }
 
-void drawPerson(const Person &p){
-    float swing = sinf(simTime*6.0f + p.phase) * 8.0f;
+void drawPerson(const SceneView &scene, const Transform &p, const Kinematics &m, const RenderStyle &rs){
+    float swing = sinf(scene.simTime*6.0f + rs.phase) * 8.0f;
     drawFilledCircle((int)p.x, (int)(p.y + 18), 6);
     glColor3f(0.95f,0.95f,0.98f);
     drawLineDDA((int)p.x, (int)(p.y+12), (int)p.x, (int)(p.y-8));
-    drawLineDDA((int)p.x, (int)(p.y+6), (int)(p.x + (int)(swing*0.6f) * p.dir), (int)(p.y+2));
-    drawLineDDA((int)p.x, (int)(p.y+6), (int)(p.x - (int)(swing*0.6f) * p.dir), (int)(p.y+2));
-    drawLineDDA((int)p.x, (int)(p.y-8), (int)(p.x + (int)(swing*0.9f) * p.dir), (int)(p.y-20));
-    drawLineDDA((int)p.x, (int)(p.y-8), (int)(p.x - (int)(swing*0.9f) * p.dir), (int)(p.y-20));
+    drawLineDDA((int)p.x, (int)(p.y+6), (int)(p.x + (int)(swing*0.6f) * m.dir), (int)(p.y+2));
+    drawLineDDA((int)p.x, (int)(p.y+6), (int)(p.x - (int)(swing*0.6f) * m.dir), (int)(p.y+2));
+    drawLineDDA((int)p.x, (int)(p.y-8), (int)(p.x + (int)(swing*0.9f) * m.dir), (int)(p.y-20));
+    drawLineDDA((int)p.x, (int)(p.y-8), (int)(p.x - (int)(swing*0.9f) * m.dir), (int)(p.y-20));
 }
 
 // ------------------ Camera timeline (simple keyframes) ------------------
-float cameraX=0.0f, cameraZoom=1.0f, camTargetX=0.0f, camTargetZoom=1.0f;
-bool cameraAuto = true;
-void updateCamera(float dt){
-    if(cameraAuto){
+void updateCamera(SceneState &scene, float dt){
+    if(scene.cameraAuto){
         // looped timeline: sweep across center and back
-        float cycle = fmod(simTime*0.03f, 1.0f); // long slow cycle
-        camTargetX = (sin(cycle*2.0f*PI)*0.5f + 0.5f) * WIN_W * 0.8f; // sweep 0..0.8*WIN_W
-        camTargetZoom = 1.0f + 0.06f * sin(simTime*0.2f);
+        float cycle = fmod(scene.simTime*0.03f, 1.0f); // long slow cycle
+        scene.camTargetX = (sin(cycle*2.0f*PI)*0.5f + 0.5f) * WORLD_W * 0.8f; // sweep 0..0.8*WORLD_W
+        scene.camTargetZoom = 1.0f + 0.06f * sin(scene.simTime*0.2f);
     }
-    cameraX += (camTargetX - cameraX) * 0.02f;
-    cameraZoom += (camTargetZoom - cameraZoom) * 0.02f;
+    scene.cameraX += (scene.camTargetX - scene.cameraX) * 0.02f;
+    scene.cameraZoom += (scene.camTargetZoom - scene.cameraZoom) * 0.02f;
 }
 
 // ------------------ Sky, day-night cycle, bloom helpers ------------------
-void drawSky(){
-    // time-of-day interpolation
-    float dayPhase = (sinf(sun.angle)+1.0f)/2.0f; // 0..1
-    // mix colors
-    for(int i=0;i<8;i++){
-        float t = i/8.0f;
-        // base colors shift with dayPhase
-        float r = 0.02f + t*(0.06f + 0.15f*dayPhase);
-        float g = 0.04f + t*(0.06f + 0.08f*dayPhase);
-        float b = 0.08f + t*(0.08f + 0.06f*dayPhase);
-        glColor3f(r,g,b);
+void drawSky(const SceneView &scene){
+    const LightingEntry &light = lightingAt(scene.sun.angle);
+    for(int i=0;i<SKY_BANDS;i++){
+        glColor3fv(light.sky[i]);
         glBegin(GL_QUADS);
-        int y0 = GROUND_Y + (i*(WIN_H-GROUND_Y)/8);
-        int y1 = GROUND_Y + ((i+1)*(WIN_H-GROUND_Y)/8);
-        glVertex2i(0,y0); glVertex2i(WIN_W*2,y0); glVertex2i(WIN_W*2,y1); glVertex2i(0,y1);
+        int y0 = GROUND_Y + (i*(WORLD_H-GROUND_Y)/SKY_BANDS);
+        int y1 = GROUND_Y + ((i+1)*(WORLD_H-GROUND_Y)/SKY_BANDS);
+        glVertex2i(0,y0); glVertex2i(WORLD_W*2,y0); glVertex2i(WORLD_W*2,y1); glVertex2i(0,y1);
         glEnd();
     }
-    // sun/moon core with bloom
-    float cx = WIN_W*1.8f * ((cosf(sun.angle)*0.5f)+0.5f); // sweep across sky
-    float cy = WIN_H - 200 + sinf(sun.angle)*60.0f;
-    // core
+    // sun/moon core (its glow comes from the light pass)
     glColor3f(1.0f,0.94f,0.8f);
-    drawFilledCircle((int)cx, (int)cy, 26);
-    // bloom (additive multiple passes)
-    if(ENABLE_BLOOM){
-        glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-        for(int k=1;k<=6;k++){
-            float a = 0.08f * (1.0f - k/8.0f);
-            drawFilledCircle((int)cx, (int)cy, 26 + k*6);
-            glColor4f(1.0f,0.94f,0.8f, a);
-        }
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); glDisable(GL_BLEND);
-    }
+    drawFilledCircle((int)light.sunX, (int)light.sunY, 26);
 }
 
-// film grain (fast randomized points)
-void drawFilmGrain(float intensity){
+// film grain (fast randomized points). Seeded from the frame number with its
+// own generator: rendering never touches the simulation's rand() sequence, so a
+// frame looks the same whether or not the frames before it were drawn.
+void drawFilmGrain(float intensity, uint32_t frame){
     if(!ENABLE_GRAIN || intensity <= 0.001f) return;
     glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
     glColor4f(0.0f,0.0f,0.0f, intensity);
     glBegin(GL_POINTS);
     int grains = 900;
+    uint32_t state = frame * 0x9E3779B9u + 1u;
+    auto next = [&state](){ state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state; };
     for(int i=0;i<grains;i++){
-        int x = rand()%WIN_W;
-        int y = rand()%WIN_H;
-        if(rand()%100 < 55) putPixel(x,y);
+        int x = next()%WIN_W;
+        int y = next()%WIN_H;
+        if(next()%100 < 55) putPixel(x,y);
     }
     glEnd();
     glDisable(GL_BLEND);
@@ -511,161 +1052,1091 @@ void drawLetterbox(float h){
 }
 
 // ------------------ Render world frame ------------------
-void renderWorld(){
-    drawSky();
-    // clouds back
-    for(auto &c: clouds) if(c.depth < 0.5f) drawCloud(c);
-    // buildings front
-    for(auto &b: buildings) drawBuilding(b,false,1.0f);
-    // reflections: blurred layered
-    glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    for(int layer=0; layer<3; ++layer){
-        float alpha = 0.25f / (1+layer*0.8f);
-        for(auto &b: buildings) drawBuilding({b.x,b.y,b.w,b.h,b.baseR,b.baseG,b.baseB,b.brightWindows,b.roofType}, true, alpha);
+// Everything the street reflects: sky, buildings, road, lamps and people.
+void renderWorld(const SceneView &scene){
+    const auto &buildings = scene.buildings;
+    {
+        ProfileScope prof(profiler, PROF_SKY);
+        refreshBuildingTints(scene);
+        drawSky(scene);
+        // clouds back
+        drawClouds(scene, false);
     }
-    glDisable(GL_BLEND);
+    {
+        // buildings front
+        ProfileScope prof(profiler, PROF_BUILDINGS);
+        for(size_t i=0;i<buildings.size();i++) drawBuilding(scene, buildings[i], &buildingTints[3*i]);
+    }
+    {
+        ProfileScope prof(profiler, PROF_GROUND);
+        // puddles
+        glColor3f(0.03f,0.05f,0.08f); drawFilledCircle(260,120,48); drawFilledCircle(620,118,78); drawFilledCircle(980,118,44);
+
+        // splashes
+        drawSplashes(scene);
+
+        // road/ground sheen
+        glColor3f(0.12f,0.12f,0.14f); drawFilledRect(0,0,WORLD_W*2,GROUND_Y);
+        glColor3f(0.18f,0.18f,0.20f); drawFilledRect(0,GROUND_Y,WORLD_W*2,22);
+        glColor3f(0.10f,0.10f,0.12f); drawFilledRect(0,40,WORLD_W*2,100);
+        glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        drawRectAlpha(0,58,WORLD_W*2,18, 0.22f,0.30f,0.38f, 0.20f);
+        glDisable(GL_BLEND);
+
+        // traffic lights indicator (draw crude poles)
+        for(auto tx : scene.trafficLightsX){
+            glColor3f(0.12f,0.12f,0.12f);
+            drawFilledRect((int)tx-6, 90, 12, 60);
+            int idx = scene.signal;
+            if(idx==0) glColor3f(0.1f,0.8f,0.1f); else if(idx==1) glColor3f(1.0f,0.9f,0.0f); else glColor3f(1.0f,0.2f,0.2f);
+            drawFilledCircle((int)tx, 180, 5);
+        }
+    }
+    {
+        // people walk above the ground line, so the street reflects them
+        ProfileScope prof(profiler, PROF_PEOPLE_DRAW);
+        const AgentArrays &agents = scene.agents;
+        for(size_t i=0;i<agents.size();i++){
+            if(agents.kind[i] == AGENT_PERSON) drawPerson(scene, agents.transform[i], agents.kinematics[i], agents.style[i]);
+        }
+    }
+}
+
+// Vehicles sit on the road below the ground line, so they are drawn over the
+// city's reflection and their own (see drawVehicleReflections).
+void drawVehicles(const SceneView &scene){
+    ProfileScope prof(profiler, PROF_VEHICLES);
+    const AgentArrays &agents = scene.agents;
+    for(size_t i=0;i<agents.size();i++){
+        AgentKind k = agents.kind[i];
+        if(k == AGENT_CAR || k == AGENT_BIKE) drawVehicle(agents.transform[i], agents.kinematics[i]);
+    }
+}
+
+// Drawn after every reflection: the rain and near clouds are in front of
+// everything.
+void renderWorldFront(const SceneView &scene){
+    // rain overlay
+    if(scene.raining){
+        ProfileScope prof(profiler, PROF_RAIN_DRAW);
+        drawRain(scene);
+    }
+
+    // clouds front
+    ProfileScope prof(profiler, PROF_CLOUDS);
+    drawClouds(scene, true);
+}
+
+// ------------------ Simulation step ------------------
+void stepSimulation(SceneState &scene, float dt){
+    scene.frame++;
+    scene.simTime += dt * TIME_SCALE;
+
+    // day-night progress
+    scene.sun.angle += dt * 0.02f * TIME_SCALE;
+    if(scene.sun.angle > 2*PI) scene.sun.angle = fmodf(scene.sun.angle, (float)(2*PI));
+    scene.dayMode = isDaytime(scene.sun.angle);
+    scene.signal = signalPhaseAt(scene.simTime);
+
+    // update systems
+    { ProfileScope prof(profiler, PROF_WINDOWS); updateWindows(scene); }
+    updateCloudLayers(scene, dt);
+    resizeRain(scene);
+    resizePeople(scene);
+    if(scene.raining){ ProfileScope prof(profiler, PROF_RAIN); updateRain(scene, dt); }
+    { ProfileScope prof(profiler, PROF_AGENT_SPEEDS); updateAgentSpeeds(scene, dt); }
+    { ProfileScope prof(profiler, PROF_PEOPLE); updatePeople(scene, dt); }
+    { ProfileScope prof(profiler, PROF_MOVE_AGENTS); moveAgents(scene, dt); }
+    { ProfileScope prof(profiler, PROF_CAMERA); updateCamera(scene, dt); }
+}
+
+// ------------------ Sim/render pipeline ------------------
+// The simulation owns simScene. After each step it copies the render-visible
+// part (a SceneView) into the back slot of a triple buffer and publishes that
+// slot with one atomic exchange;
+// display() swaps the newest published slot into front the same way. Neither
+// side waits for the other, so a frame costs max(sim, render) instead of
+// sim + render, and render only ever reads an immutable snapshot.
+class SceneExchange {
+public:
+    SceneView &back(){ return slots[backIdx]; }
+    void publish(){ backIdx = pending.exchange(backIdx | FRESH) & INDEX; }
+    bool fresh() const { return (pending.load() & FRESH) != 0; }
+    const SceneView &acquire(){
+        if(fresh()) frontIdx = pending.exchange(frontIdx) & INDEX;
+        return slots[frontIdx];
+    }
+private:
+    enum { INDEX = 3, FRESH = 4 };
+    SceneView slots[3];
+    int backIdx = 0, frontIdx = 2;  // each touched by one thread only
+    std::atomic<int> pending{1};
+};
+
+SceneState simScene;
+SceneExchange sceneExchange;
+
+// Input arrives on the GLUT thread; the simulation applies it between steps.
+std::mutex simCommandMutex;
+std::vector<std::function<void(SceneState&)>> simCommands;
+
+void postSimCommand(std::function<void(SceneState&)> cmd){
+    std::lock_guard<std::mutex> lock(simCommandMutex);
+    simCommands.push_back(std::move(cmd));
+}
+
+void applySimCommands(SceneState &scene){
+    std::vector<std::function<void(SceneState&)>> cmds;
+    { std::lock_guard<std::mutex> lock(simCommandMutex); cmds.swap(simCommands); }
+    for(auto &cmd : cmds) cmd(scene);
+}
+
+// Render-side settings changed from other threads take effect at the start
+// of the next frame.
+std::mutex renderCommandMutex;
+std::vector<std::function<void()>> renderCommands;
+
+void postRenderCommand(std::function<void()> cmd){
+    std::lock_guard<std::mutex> lock(renderCommandMutex);
+    renderCommands.push_back(std::move(cmd));
+}
+
+void applyRenderCommands(){
+    std::vector<std::function<void()>> cmds;
+    { std::lock_guard<std::mutex> lock(renderCommandMutex); cmds.swap(renderCommands); }
+    for(auto &cmd : cmds) cmd();
+}
+
+// What the render thread saw, for the control endpoint's metrics reply.
+struct FrameMetrics {
+    std::mutex mutex;
+    std::vector<float> frameMs = std::vector<float>(240, 0.0f); // ring of recent frame times
+    uint64_t frames = 0;
+    size_t drops = 0, splashes = 0;
+    int dropTarget = 0;
+    int agents[AGENT_KIND_COUNT] = {0, 0, 0, 0};
+    float renderScale = 1.0f;   // RENDER_SCALE belongs to the render thread; this is its copy
+};
+FrameMetrics frameMetrics;
+
+void recordFrameCounts(const SceneView &scene){
+    const int *counts = scene.agents.kindCount;
+    std::lock_guard<std::mutex> lock(frameMetrics.mutex);
+    frameMetrics.drops = scene.drops.size();
+    frameMetrics.splashes = scene.splashes.size();
+    frameMetrics.dropTarget = scene.dropTarget;
+    std::copy(counts, counts + AGENT_KIND_COUNT, frameMetrics.agents);
+}
+
+void recordFrameTime(float ms){
+    std::lock_guard<std::mutex> lock(frameMetrics.mutex);
+    frameMetrics.frameMs[frameMetrics.frames++ % frameMetrics.frameMs.size()] = ms;
+    frameMetrics.renderScale = RENDER_SCALE;
+}
+
+void simTick(){
+    ProfileScope prof(profiler, PROF_SIM_TICK);
+    applySimCommands(simScene);
+    stepSimulation(simScene, FRAME_MS / 1000.0f);
+    publishScene(sceneExchange.back(), simScene);
+    sceneExchange.publish();
+}
+
+std::atomic<bool> simRunning{false};
+std::thread simThread;
+
+void simulationLoop(){
+    auto next = std::chrono::steady_clock::now();
+    while(simRunning.load()){
+        simTick();
+        next += std::chrono::milliseconds(FRAME_MS);
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void stopSimulation(){
+    if(!simRunning.exchange(false)) return;
+    simThread.join();
+}
+
+// pipelined: repaint as soon as the sim thread publishes a new frame
+void pollScene(int v){
+    if(sceneExchange.fresh()) glutPostRedisplay();
+    glutTimerFunc(2, pollScene, 0);
+}
+
+// single-threaded fallback: step and draw on the GLUT timer
+void animate(int v){
+    simTick();
+    glutPostRedisplay();
+    glutTimerFunc(FRAME_MS, animate, 0);
+}
+
+// ------------------ Internal render target + upscale ------------------
+// The world is rasterized into the bottom-left RENDER_SCALE portion of the back
+// buffer, copied into a texture and stretched over the window. HUD layers are
+// drawn afterwards at native resolution.
+GLuint sceneTex = 0;
+int sceneTexW = 0, sceneTexH = 0;   // power-of-two backing store
+int renderW = 1, renderH = 1;       // current internal resolution
+float viewW = WORLD_W;              // visible world width (keeps aspect, height is WORLD_H)
+float frameMsAvg = FRAME_MS;
+int framesSinceScale = 0;
 
-    // puddles
-    glColor3f(0.03f,0.05f,0.08f); drawFilledCircle(260,120,48); drawFilledCircle(620,118,78); drawFilledCircle(980,118,44);
+int nextPow2(int v){ int p=1; while(p<v) p<<=1; return p; }
 
-    // splashes
-    drawSplashes();
+void ensureSceneTarget(){
+    int tw = nextPow2(WIN_W), th = nextPow2(WIN_H);
+    if(sceneTex && tw==sceneTexW && th==sceneTexH) return;
+    if(!sceneTex) glGenTextures(1, &sceneTex);
+    glBindTexture(GL_TEXTURE_2D, sceneTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, tw, th, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    sceneTexW = tw; sceneTexH = th;
+}
 
-    // road/ground sheen
-    glColor3f(0.12f,0.12f,0.14f); drawFilledRect(0,0,WIN_W*2,GROUND_Y);
-    glColor3f(0.18f,0.18f,0.20f); drawFilledRect(0,GROUND_Y,WIN_W*2,22);
-    glColor3f(0.10f,0.10f,0.12f); drawFilledRect(0,40,WIN_W*2,100);
+// drive RENDER_SCALE from the smoothed frame cost, with hysteresis
+void adaptRenderScale(float frameMs){
+    frameMsAvg += (frameMs - frameMsAvg) * 0.1f;
+    if(!AUTO_RENDER_SCALE || ++framesSinceScale < 30) return;
+    framesSinceScale = 0;
+    if(frameMsAvg > FRAME_MS*0.9f) RENDER_SCALE = std::max(MIN_RENDER_SCALE, RENDER_SCALE - 0.05f);
+    else if(frameMsAvg < FRAME_MS*0.6f) RENDER_SCALE = std::min(1.0f, RENDER_SCALE + 0.05f);
+}
+
+void setPixelProjection(int w,int h){
+    glViewport(0,0,w,h);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(0, w, 0, h);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
+
+// stretch the internal target over the whole window
+void upscaleSceneTarget(){
+    glBindTexture(GL_TEXTURE_2D, sceneTex);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, renderW, renderH);
+    setPixelProjection(WIN_W, WIN_H);
+    float u = renderW/(float)sceneTexW, v = renderH/(float)sceneTexH;
+    glEnable(GL_TEXTURE_2D);
+    glColor3f(1.0f,1.0f,1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0,0); glVertex2i(0,0);
+    glTexCoord2f(u,0); glVertex2i(WIN_W,0);
+    glTexCoord2f(u,v); glVertex2i(WIN_W,WIN_H);
+    glTexCoord2f(0,v); glVertex2i(0,WIN_H);
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+}
+
+// ------------------ Street reflection ------------------
+// Screen-space reflection: the rows just above a mirror line are already in
+// the render target, so they are copied into a texture and drawn back flipped
+// below the line. Two bilinear taps that spread apart with distance give a
+// vertical blur, each strip of rows is shifted sideways for ripples, and the
+// result fades out away from the line. Cost scales with the reflected rows.
+// Vehicles sit below the ground line, so they get their own mirrored pass
+// (drawVehicleReflections).
+GLuint reflectTex = 0;
+int reflectTexW = 0, reflectTexH = 0;
+const float REFLECT_STRENGTH = 0.45f; // coverage of the reflection at the mirror line
+const int REFLECT_STRIP = 2;          // rows per ripple strip
+
+void drawStreetReflection(const SceneView &scene){
+    // the ground line in target pixels (world y -> camera zoom -> viewport)
+    float groundView = (GROUND_Y - WORLD_H/2.0f) * scene.cameraZoom + WORLD_H/2.0f;
+    int groundPx = (int)(groundView * renderH / WORLD_H + 0.5f);
+    int rows = std::min(groundPx, renderH - groundPx);
+    if(rows <= 0) return;
+
+    if(!reflectTex) glGenTextures(1, &reflectTex);
+    glBindTexture(GL_TEXTURE_2D, reflectTex);
+    if(nextPow2(renderW) > reflectTexW || nextPow2(rows) > reflectTexH){
+        reflectTexW = std::max(reflectTexW, nextPow2(renderW));
+        reflectTexH = std::max(reflectTexH, nextPow2(rows));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, reflectTexW, reflectTexH, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    }
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, groundPx, renderW, rows);
+
+    glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity(); gluOrtho2D(0, renderW, 0, renderH);
+    glMatrixMode(GL_MODELVIEW); glPushMatrix(); glLoadIdentity();
+    glEnable(GL_TEXTURE_2D);
     glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    drawRectAlpha(0,58,WIN_W*2,18, 0.22f,0.30f,0.38f, 0.20f);
+
+    float du = 1.0f / reflectTexW, dv = 1.0f / reflectTexH;
+    float uMax = renderW * du;
+    float ripplePx = 3.0f * renderH / (float)WIN_H;
+    // equal weights for both taps under "over" blending: a1*(1-a2) == a2
+    const float a2 = REFLECT_STRENGTH * 0.5f, a1 = a2 / (1.0f - a2);
+    for(int tap=0; tap<2; ++tap){
+        float sign = tap ? 1.0f : -1.0f, alpha = tap ? a2 : a1;
+        glBegin(GL_QUADS);
+        for(int y=0; y<rows; y+=REFLECT_STRIP){
+            int y1 = std::min(rows, y + REFLECT_STRIP);
+            float t0 = y / (float)rows, t1 = y1 / (float)rows;
+            float shift = ripplePx * t0 * sinf(y*0.35f + scene.simTime*3.0f) * du;
+            float blur0 = sign * (0.5f + 3.0f*t0) * dv, blur1 = sign * (0.5f + 3.0f*t1) * dv;
+            glColor4f(0.55f,0.62f,0.75f, alpha * (1.0f - t0));
+            glTexCoord2f(shift, y*dv + blur0); glVertex2i(0, groundPx - y);
+            glTexCoord2f(uMax + shift, y*dv + blur0); glVertex2i(renderW, groundPx - y);
+            glColor4f(0.55f,0.62f,0.75f, alpha * (1.0f - t1));
+            glTexCoord2f(uMax + shift, y1*dv + blur1); glVertex2i(renderW, groundPx - y1);
+            glTexCoord2f(shift, y1*dv + blur1); glVertex2i(0, groundPx - y1);
+        }
+        glEnd();
+    }
+
     glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+    glMatrixMode(GL_PROJECTION); glPopMatrix();
+    glMatrixMode(GL_MODELVIEW); glPopMatrix();
+}
 
-    // traffic lights indicator (draw crude poles)
-    for(auto tx : trafficLightsX){
-        glColor3f(0.12f,0.12f,0.12f);
-        drawFilledRect((int)tx-6, 90, 12, 60);
-        // simple light: alternate with simTime to feel alive
-        int idx = (int)(simTime*1.5f) % 3;
-        if(idx==0) glColor3f(0.1f,0.8f,0.1f); else if(idx==1) glColor3f(1.0f,0.9f,0.0f); else glColor3f(1.0f,0.2f,0.2f);
-        drawFilledCircle((int)tx, 180, 5);
+// ------------------ Light accumulation ------------------
+// Every emitter (headlights, signal lamps, lit windows, the sun/moon) is one
+// soft sprite splatted additively into a quarter-resolution region of the
+// back buffer, before the world is drawn there. The region is copied into
+// lightTex and blurred once (a horizontal and a vertical 1-4-6-4-1 pass at
+// quarter resolution, three bilinear taps each). Once the vehicles are drawn,
+// one bilinear quad adds it over the whole target. Fill per light is 1/16 of
+// full resolution and the blur and composite do not depend on the number of
+// lights.
+GLuint lightTex = 0, lightSpriteTex = 0;
+int lightTexW = 0, lightTexH = 0;
+int lightW = 1, lightH = 1;     // accumulation size this frame
+const int LIGHT_DOWNSCALE = 4;
+const int LIGHT_PAD = 2;        // blur reach in texels; kept black around the region
+const int LIGHT_SPRITE = 64;
+
+void ensureLightTargets(){
+    if(!lightSpriteTex){
+        // radial falloff (1 - r^2)^2 as alpha, tinted per emitter
+        std::vector<uint8_t> texels(LIGHT_SPRITE * LIGHT_SPRITE);
+        for(int y=0;y<LIGHT_SPRITE;y++) for(int x=0;x<LIGHT_SPRITE;x++){
+            float dx = (x + 0.5f) / LIGHT_SPRITE * 2.0f - 1.0f, dy = (y + 0.5f) / LIGHT_SPRITE * 2.0f - 1.0f;
+            float f = std::max(0.0f, 1.0f - (dx*dx + dy*dy));
+            texels[y*LIGHT_SPRITE + x] = (uint8_t)(f * f * 255.0f + 0.5f);
+        }
+        glGenTextures(1, &lightSpriteTex);
+        glBindTexture(GL_TEXTURE_2D, lightSpriteTex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, LIGHT_SPRITE, LIGHT_SPRITE, 0, GL_ALPHA, GL_UNSIGNED_BYTE, texels.data());
     }
+    lightW = std::max(1, renderW / LIGHT_DOWNSCALE);
+    lightH = std::max(1, renderH / LIGHT_DOWNSCALE);
+    if(!lightTex) glGenTextures(1, &lightTex);
+    glBindTexture(GL_TEXTURE_2D, lightTex);
+    if(nextPow2(lightW + LIGHT_PAD) > lightTexW || nextPow2(lightH + LIGHT_PAD) > lightTexH){
+        lightTexW = std::max(lightTexW, nextPow2(lightW + LIGHT_PAD));
+        lightTexH = std::max(lightTexH, nextPow2(lightH + LIGHT_PAD));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, lightTexW, lightTexH, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+    }
+}
 
-    // vehicles
-    for(auto &v : cars) drawVehicle(v);
-    for(auto &v : bikes) drawVehicle(v);
+// one sprite quad centered on (x,y) with half extents rx, ry; inside glBegin(GL_QUADS)
+void splatLight(float x, float y, float rx, float ry){
+    glTexCoord2f(0,0); glVertex2f(x-rx, y-ry);
+    glTexCoord2f(1,0); glVertex2f(x+rx, y-ry);
+    glTexCoord2f(1,1); glVertex2f(x+rx, y+ry);
+    glTexCoord2f(0,1); glVertex2f(x-rx, y+ry);
+}
 
-    // people
-    for(auto &p : people) drawPerson(p);
+void splatEmitters(const SceneView &scene){
+    const LightingEntry &light = lightingAt(scene.sun.angle);
+    float night = scene.dayMode ? 0.35f : 1.0f;
+    glBindTexture(GL_TEXTURE_2D, lightSpriteTex);
+    glBegin(GL_QUADS);
+    // sun/moon halo
+    glColor4f(1.0f,0.94f,0.8f, 0.55f);
+    splatLight(light.sunX, light.sunY, 70, 70);
+    // lit windows
+    glColor4f(1.0f,0.85f,0.55f, 0.22f * night);
+    for(size_t i=0;i<scene.buildings.size();i++){
+        const Building &b = scene.buildings[i];
+        const uint32_t *rows = scene.windowLit.data() + b.litRow;
+        for(int r=0; r<b.winRows; r++){
+            for(uint32_t bits = rows[r]; bits; bits &= bits - 1) splatLight(b.x + 10 + 18*__builtin_ctz(bits), b.y + 12 + 22*r, 12, 12);
+        }
+    }
+    // signal lamps
+    static const float lamp[3][3] = {{0.1f,0.8f,0.1f}, {1.0f,0.9f,0.0f}, {1.0f,0.2f,0.2f}};
+    glColor4f(lamp[scene.signal][0], lamp[scene.signal][1], lamp[scene.signal][2], 0.7f * night);
+    for(auto tx : scene.trafficLightsX) splatLight(tx, 180, 30, 30);
+    // headlights: a bright lamp and a long cone ahead of every car and bike
+    const AgentArrays &agents = scene.agents;
+    for(size_t i=0;i<agents.size();i++){
+        AgentKind k = agents.kind[i];
+        if(k != AGENT_CAR && k != AGENT_BIKE) continue;
+        const Transform &t = agents.transform[i];
+        float front = agents.kinematics[i].dir == 1 ? t.x + 80 : t.x;
+        float ahead = (float)agents.kinematics[i].dir;
+        glColor4f(1.0f,0.98f,0.8f, 0.9f * night);
+        splatLight(front, t.y + 14, 10, 8);
+        glColor4f(1.0f,0.98f,0.8f, 0.45f * night);
+        splatLight(front + ahead*60, t.y + 12, 64, 16);
+    }
+    glEnd();
+}
 
-    // rain overlay
-    if(raining){
-        drawRain();
+// the rest of the buffer is still clear, so only the light region is wiped
+void clearLightRegion(){
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, lightW + LIGHT_PAD, lightH + LIGHT_PAD);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+// One blur pass along (du,dv), summed additively. The outer 4+1 taps of
+// 1-4-6-4-1 are fetched as one bilinear sample 1.2 texels out, so the kernel
+// is 5-6-5 over 16: every tap is rounded to 8 bits in the framebuffer, and at
+// 1/16 a dim emitter's edge rounded away to nothing.
+void blurLightTarget(float du, float dv){
+    const float weights[3] = {5/16.0f, 6/16.0f, 5/16.0f};
+    const float offsets[3] = {-1.2f, 0.0f, 1.2f};
+    float u = lightW / (float)lightTexW, v = lightH / (float)lightTexH;
+    clearLightRegion();
+    glBegin(GL_QUADS);
+    for(int k=0;k<3;k++){
+        float ou = offsets[k]*du, ov = offsets[k]*dv;
+        glColor3f(weights[k], weights[k], weights[k]);
+        glTexCoord2f(ou,ov); glVertex2i(0,0);
+        glTexCoord2f(u+ou,ov); glVertex2i(lightW,0);
+        glTexCoord2f(u+ou,v+ov); glVertex2i(lightW,lightH);
+        glTexCoord2f(ou,v+ov); glVertex2i(0,lightH);
     }
+    glEnd();
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, lightW + LIGHT_PAD, lightH + LIGHT_PAD);
+}
 
-    // clouds front
-    for(auto &c: clouds) if(c.depth >= 0.5f) drawCloud(c);
+// Fills lightTex. Expects the world camera on the matrix stacks and a cleared
+// buffer; leaves the buffer cleared and the viewport on the render target.
+void accumulateLights(const SceneView &scene){
+    ensureLightTargets();
+    glViewport(0, 0, lightW, lightH);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+    splatEmitters(scene);
+    glBindTexture(GL_TEXTURE_2D, lightTex);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, lightW + LIGHT_PAD, lightH + LIGHT_PAD);
+
+    glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity(); gluOrtho2D(0, lightW, 0, lightH);
+    glMatrixMode(GL_MODELVIEW); glPushMatrix(); glLoadIdentity();
+    glBlendFunc(GL_ONE, GL_ONE);
+    blurLightTarget(1.0f / lightTexW, 0.0f);
+    blurLightTarget(0.0f, 1.0f / lightTexH);
+    glMatrixMode(GL_PROJECTION); glPopMatrix();
+    glMatrixMode(GL_MODELVIEW); glPopMatrix();
+
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+    glViewport(0, 0, renderW, renderH);
+    clearLightRegion();
+}
+
+// add the blurred lights over the whole render target
+void compositeLights(){
+    glMatrixMode(GL_PROJECTION); glPushMatrix(); glLoadIdentity(); gluOrtho2D(0, renderW, 0, renderH);
+    glMatrixMode(GL_MODELVIEW); glPushMatrix(); glLoadIdentity();
+    float u = lightW / (float)lightTexW, v = lightH / (float)lightTexH;
+    glBindTexture(GL_TEXTURE_2D, lightTex);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND); glBlendFunc(GL_ONE, GL_ONE);
+    glColor3f(1.0f,1.0f,1.0f);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0,0); glVertex2i(0,0);
+    glTexCoord2f(u,0); glVertex2i(renderW,0);
+    glTexCoord2f(u,v); glVertex2i(renderW,renderH);
+    glTexCoord2f(0,v); glVertex2i(0,renderH);
+    glEnd();
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+    glMatrixMode(GL_PROJECTION); glPopMatrix();
+    glMatrixMode(GL_MODELVIEW); glPopMatrix();
+}
+
+// Vehicles and their headlights flipped at each vehicle's wheel line into the
+// road below, drawn directly rather than copied: the rows above the wheels
+// already hold the city's ground-line reflection, and copying them would
+// reflect a reflection. Goes under the vehicles, over the street reflection.
+const float WHEEL_DROP = 14.0f; // wheel bottoms sit this far below a vehicle's y
+const float ROAD_REFLECT_REACH = 58.0f; // world units below the wheels until it fades out
+
+void drawVehicleReflections(const SceneView &scene){
+    const AgentArrays &agents = scene.agents;
+    float a = REFLECT_STRENGTH;
+    auto fade = [&](float depth){ return a * std::max(0.0f, 1.0f - depth / ROAD_REFLECT_REACH); };
+    glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glBegin(GL_QUADS);
+    for(size_t i=0;i<agents.size();i++){
+        AgentKind k = agents.kind[i];
+        if(k != AGENT_CAR && k != AGENT_BIKE) continue;
+        const Transform &t = agents.transform[i];
+        float line = t.y - WHEEL_DROP;
+        // body: 26 tall, starting WHEEL_DROP above the line, tinted like the street reflection
+        float near = line - WHEEL_DROP, far = near - 26;
+        glColor4f(0.92f*0.55f, 0.24f*0.62f, 0.22f*0.75f, fade(WHEEL_DROP));
+        glVertex2f(t.x, near); glVertex2f(t.x + 80, near);
+        glColor4f(0.92f*0.55f, 0.24f*0.62f, 0.22f*0.75f, fade(WHEEL_DROP + 26));
+        glVertex2f(t.x + 80, far); glVertex2f(t.x, far);
+        // wheels: centers 8 above the line, mirrored 8 below it
+        glColor4f(0.08f, 0.08f, 0.08f, fade(8));
+        for(float wx : {t.x + 16, t.x + 64}){
+            glVertex2f(wx - 8, line); glVertex2f(wx + 8, line);
+            glVertex2f(wx + 8, line - 16); glVertex2f(wx - 8, line - 16);
+        }
+    }
+    glEnd();
+    if(ENABLE_BLOOM){
+        // the lamp and cone splats of splatEmitters, mirrored, added at full resolution
+        float night = scene.dayMode ? 0.35f : 1.0f;
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+        glEnable(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, lightSpriteTex);
+        glBegin(GL_QUADS);
+        for(size_t i=0;i<agents.size();i++){
+            AgentKind k = agents.kind[i];
+            if(k != AGENT_CAR && k != AGENT_BIKE) continue;
+            const Transform &t = agents.transform[i];
+            float line = t.y - WHEEL_DROP;
+            float front = agents.kinematics[i].dir == 1 ? t.x + 80 : t.x;
+            float ahead = (float)agents.kinematics[i].dir;
+            glColor4f(1.0f,0.98f,0.8f, 0.9f * night * fade(WHEEL_DROP + 14));
+            splatLight(front, line - WHEEL_DROP - 14, 10, 8);
+            glColor4f(1.0f,0.98f,0.8f, 0.45f * night * fade(WHEEL_DROP + 12));
+            splatLight(front + ahead*60, line - WHEEL_DROP - 12, 64, 16);
+        }
+        glEnd();
+        glDisable(GL_TEXTURE_2D);
+    }
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA); glDisable(GL_BLEND);
 }
 
 // ------------------ Display + camera transform ------------------
-void display(){
+// one frame: world at internal resolution, upscale, then native-resolution overlays
+void renderFrame(){
+    applyRenderCommands();
+    const SceneView &scene = sceneExchange.acquire();
+    recordFrameCounts(scene);
+    ensureSceneTarget();
+    renderW = std::max(1, (int)(WIN_W*RENDER_SCALE));
+    renderH = std::max(1, (int)(WIN_H*RENDER_SCALE));
+
+    glViewport(0,0,renderW,renderH);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(0, viewW, 0, WORLD_H);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    // primitives plot one point per world unit; grow points so they still cover
+    glPointSize(std::max(1.2f, ceilf(scene.cameraZoom * renderH / (float)WORLD_H)));
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glPushMatrix();
     // center, scale, then translate world for cameraX
-    glTranslatef(WIN_W/2.0f, WIN_H/2.0f, 0.0f);
-    glScalef(cameraZoom, cameraZoom, 1.0f);
-    glTranslatef(-WIN_W/2.0f - cameraX, -WIN_H/2.0f, 0.0f);
+    glTranslatef(viewW/2.0f, WORLD_H/2.0f, 0.0f);
+    glScalef(scene.cameraZoom, scene.cameraZoom, 1.0f);
+    glTranslatef(-viewW/2.0f - scene.cameraX, -WORLD_H/2.0f, 0.0f);
 
-    renderWorld();
+    if(ENABLE_BLOOM){ ProfileScope prof(profiler, PROF_LIGHT_SPLAT); accumulateLights(scene); }
+    renderWorld(scene);
+    { ProfileScope prof(profiler, PROF_REFLECTIONS); drawStreetReflection(scene); }
+    { ProfileScope prof(profiler, PROF_ROAD_REFLECTIONS); drawVehicleReflections(scene); }
+    drawVehicles(scene);
+    if(ENABLE_BLOOM){ ProfileScope prof(profiler, PROF_LIGHT_COMPOSITE); compositeLights(); }
+    renderWorldFront(scene);
 
     glPopMatrix();
 
-    // cinematic overlays
+    {
+        ProfileScope prof(profiler, PROF_UPSCALE);
+        if(renderW != WIN_W || renderH != WIN_H) upscaleSceneTarget();
+        else setPixelProjection(WIN_W, WIN_H);
+    }
+    glPointSize(1.0f);
+
+    // cinematic overlays (native resolution)
     if(cinematic){
+        ProfileScope prof(profiler, PROF_OVERLAYS);
         drawLetterbox(40.0f);
         // vignette - quick darken edges
         glEnable(GL_BLEND); glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         drawRectAlpha(0,0,WIN_W,WIN_H, 0.0f,0.0f,0.0f,0.0f); // placeholder (we keep subtle)
         glDisable(GL_BLEND);
-        drawFilmGrain(dayMode?0.02f:0.06f);
+        drawFilmGrain(scene.dayMode?0.02f:0.06f, scene.frame);
     }
-
-    glutSwapBuffers();
 }
 
-// ------------------ Animation tick ------------------
-void animate(int v){
-    float dt = FRAME_MS / 1000.0f;
-    simTime += dt * TIME_SCALE;
-
-    // day-night progress
-    sun.angle += dt * 0.02f * TIME_SCALE;
-    if(sun.angle > 2*PI) sun.angle -= 2*PI;
-    dayMode = (cosf(sun.angle) > -0.2f); // crude day detect
-
-    // update systems
-    updateClouds(dt);
-    if(raining) updateRain(dt);
-    updateVehicles(dt);
-    updatePeople(dt);
-    updateCamera(dt);
-    glutPostRedisplay();
-    glutTimerFunc(FRAME_MS, animate, 0);
+void display(){
+    static int profiledFrames = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    { ProfileScope prof(profiler, PROF_FRAME); renderFrame(); }
+    float frameMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - t0).count();
+    adaptRenderScale(frameMs);
+    recordFrameTime(frameMs);
+    if(profiler.enabled && ++profiledFrames % PROFILE_PRINT_EVERY == 0) profiler.printFrame(stdout);
+    glutSwapBuffers();
 }
 
 // ------------------ Input handlers ------------------
 void keyboard(unsigned char key, int x, int y){
     switch(key){
-        case 'r': raining = !raining; break;
-        case 'd': sun.angle += 0.8f; break; // advance time
-        case 't': cameraAuto = !cameraAuto; break;
+        case 'r': postSimCommand([](SceneState &s){ s.raining = !s.raining; }); break;
+        case 'd': postSimCommand([](SceneState &s){ s.sun.angle += 0.8f; }); break; // advance time
+        case 't': postSimCommand([](SceneState &s){ s.cameraAuto = !s.cameraAuto; }); break;
         case 'c': cinematic = !cinematic; break;
-        case 'p': spawnPeople(18); break;
-        case 'b': spawnVehicles(); break;
-        case '+': camTargetZoom = std::min(1.8f, camTargetZoom + 0.08f); break;
-        case '-': camTargetZoom = std::max(0.6f, camTargetZoom - 0.08f); break;
-        case 27: exit(0); break;
+        case 'p': postSimCommand([](SceneState &s){ spawnPeople(s, 18); }); break;
+        case 'b': postSimCommand([](SceneState &s){ spawnVehicles(s); }); break;
+        case 'o': postSimCommand([](SceneState &s){ s.overcast = !s.overcast; initClouds(s, s.overcast ? 320 : 14); }); break;
+        case '+': postSimCommand([](SceneState &s){ s.camTargetZoom = std::min(1.8f, s.camTargetZoom + 0.08f); }); break;
+        case '-': postSimCommand([](SceneState &s){ s.camTargetZoom = std::max(0.6f, s.camTargetZoom - 0.08f); }); break;
+        case 'a': AUTO_RENDER_SCALE = !AUTO_RENDER_SCALE; break;
+        case '[': AUTO_RENDER_SCALE = false; RENDER_SCALE = std::max(MIN_RENDER_SCALE, RENDER_SCALE - 0.1f); break;
+        case ']': AUTO_RENDER_SCALE = false; RENDER_SCALE = std::min(1.0f, RENDER_SCALE + 0.1f); break;
+        case 27:
+            stopSimulation();
+            if(profiler.enabled) profiler.printSummary(stdout);
+            exit(0);
+            break;
     }
 }
 
 void special(int key,int x,int y){
-    if(!cameraAuto){
-        if(key == GLUT_KEY_LEFT) camTargetX = std::max(0.0f, camTargetX - 40.0f);
-        if(key == GLUT_KEY_RIGHT) camTargetX = std::min((float)WIN_W, camTargetX + 40.0f);
+    postSimCommand([key](SceneState &s){
+        if(s.cameraAuto) return;
+        if(key == GLUT_KEY_LEFT) s.camTargetX = std::max(0.0f, s.camTargetX - 40.0f);
+        if(key == GLUT_KEY_RIGHT) s.camTargetX = std::min((float)WORLD_W, s.camTargetX + 40.0f);
+    });
+}
+
+// ------------------ Control endpoint ------------------
+// --control PATH listens on a Unix domain socket, on its own thread. One text
+// command per line:
+//   set NAME VALUE   NAME: RAIN_PARTICLES, MAX_SPLASHES, TIME_SCALE, ENABLE_BLOOM,
+//                    ENABLE_GRAIN, ENABLE_PROFILING or PEDESTRIANS (crowd size)
+//   metrics          frame-time percentiles, entity counts, per-pass times
+// Replies end with a line "end". Sim settings go through postSimCommand and
+// render settings through postRenderCommand, so both land on frame boundaries.
+// Counts are clamped as doubles, before the cast, so no value overflows int.
+int controlCount(double value, double maxCount){ return (int)std::max(0.0, std::min(value, maxCount)); }
+
+std::string applyControl(const std::string &name, double value){
+    if(!std::isfinite(value)) return "error: value must be finite";
+    if(name == "RAIN_PARTICLES"){
+        int n = controlCount(value, 2000000);
+        postSimCommand([n](SceneState &s){ RAIN_PARTICLES = n; s.dropTarget = n; });
+    } else if(name == "MAX_SPLASHES"){
+        int n = controlCount(value, 1000000);
+        postSimCommand([n](SceneState &){ MAX_SPLASHES = n; });
+    } else if(name == "TIME_SCALE"){
+        float v = (float)std::max(0.0, std::min(value, (double)MAX_TIME_SCALE));
+        postSimCommand([v](SceneState &){ TIME_SCALE = v; });
+    } else if(name == "PEDESTRIANS"){
+        int n = controlCount(value, 1000000);
+        postSimCommand([n](SceneState &s){ s.peopleTarget = n; });
+    } else if(name == "ENABLE_BLOOM"){
+        bool on = value != 0;
+        postRenderCommand([on]{ ENABLE_BLOOM = on; });
+    } else if(name == "ENABLE_GRAIN"){
+        bool on = value != 0;
+        postRenderCommand([on]{ ENABLE_GRAIN = on; });
+    } else if(name == "ENABLE_PROFILING"){
+        profiler.enabled = value != 0; // scopes latch it on entry
+    } else {
+        return "error: unknown parameter " + name;
     }
+    return "ok";
+}
+
+std::string controlMetrics(){
+    std::ostringstream out;
+    std::vector<float> ms;
+    {
+        std::lock_guard<std::mutex> lock(frameMetrics.mutex);
+        size_t n = (size_t)std::min<uint64_t>(frameMetrics.frames, frameMetrics.frameMs.size());
+        ms.assign(frameMetrics.frameMs.begin(), frameMetrics.frameMs.begin() + n);
+        out << "frames " << frameMetrics.frames << "\n";
+        out << "drops " << frameMetrics.drops << "\n";
+        out << "drop_target " << frameMetrics.dropTarget << "\n";
+        out << "splashes " << frameMetrics.splashes << "\n";
+        out << "cars " << frameMetrics.agents[AGENT_CAR] << "\n";
+        out << "bikes " << frameMetrics.agents[AGENT_BIKE] << "\n";
+        out << "people " << frameMetrics.agents[AGENT_PERSON] << "\n";
+        out << "clouds " << frameMetrics.agents[AGENT_CLOUD] << "\n";
+        out << "render_scale " << frameMetrics.renderScale << "\n";
+    }
+    std::sort(ms.begin(), ms.end());
+    if(!ms.empty()){
+        out << "frame_ms_p50 " << ms[ms.size()/2] << "\n";
+        out << "frame_ms_p95 " << ms[ms.size()*95/100] << "\n";
+        out << "frame_ms_p99 " << ms[ms.size()*99/100] << "\n";
+        out << "frame_ms_max " << ms.back() << "\n";
+    }
+    if(profiler.enabled){
+        std::vector<double> us = profiler.lastMicros();
+        for(int i=0;i<profiler.sectionCount();i++){
+            if(us[i] < 0) continue;
+            std::string name = profiler.sectionName(i);
+            name.erase(0, name.find_first_not_of(' '));
+            std::replace(name.begin(), name.end(), ' ', '_');
+            out << "pass_us." << name << " " << us[i] << "\n";
+        }
+    }
+    return out.str();
+}
+
+std::string handleControlLine(const std::string &line){
+    std::istringstream in(line);
+    std::string cmd, name;
+    double value;
+    in >> cmd;
+    if(cmd == "set" && (in >> name >> value)) return applyControl(name, value) + "\n";
+    if(cmd == "metrics") return controlMetrics();
+    return "error: expected 'set NAME VALUE' or 'metrics'\n";
+}
+
+#ifndef _WIN32
+std::string controlSocketPath; // removed at exit
+void removeControlSocket(){
+    struct stat st;
+    if(!controlSocketPath.empty() && lstat(controlSocketPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(controlSocketPath.c_str());
+}
+const size_t CONTROL_MAX_LINE = 4096; // longer unterminated input drops the client
+void serveControl(int listenFd){
+    for(;;){
+        int fd = accept(listenFd, NULL, NULL);
+        if(fd < 0){
+            if(errno == EINTR || errno == EAGAIN || errno == ECONNABORTED) continue;
+            if(errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM){
+                std::this_thread::sleep_for(std::chrono::milliseconds(100)); // wait for descriptors to free up
+                continue;
+            }
+            perror("control accept");
+            close(listenFd);
+            return;
+        }
+        std::string pending;
+        char buf[512];
+        ssize_t got;
+        while((got = recv(fd, buf, sizeof(buf), 0)) > 0){
+            pending.append(buf, (size_t)got);
+            size_t nl;
+            while((nl = pending.find('\n')) != std::string::npos){
+                std::string reply = handleControlLine(pending.substr(0, nl)) + "end\n";
+                pending.erase(0, nl + 1);
+                send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+            }
+            if(pending.size() > CONTROL_MAX_LINE){
+                static const char tooLong[] = "error: line too long\nend\n";
+                send(fd, tooLong, sizeof(tooLong) - 1, MSG_NOSIGNAL);
+                break;
+            }
+        }
+        close(fd);
+    }
+}
+#endif
+
+bool startControlEndpoint(const std::string &path){
+#ifdef _WIN32
+    std::cerr << "--control needs Unix domain sockets; not available on Windows" << std::endl;
+    return false;
+#else
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path)){ std::cerr << "Control socket path too long" << std::endl; return false; }
+    strcpy(addr.sun_path, path.c_str());
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct stat st;
+    if(lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path.c_str()); // stale socket from an earlier run; never a regular file
+    if(fd < 0 || bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 4) != 0){
+        perror("control socket");
+        if(fd >= 0) close(fd);
+        return false;
+    }
+    controlSocketPath = path;
+    atexit(removeControlSocket);
+    std::thread(serveControl, fd).detach();
+    std::cout << "Control endpoint on " << path << std::endl;
+    return true;
+#endif
 }
 
 // ------------------ Init & main ------------------
-void initScene(){
-    srand((unsigned)time(NULL));
-    buildCity();
-    initClouds();
-    initDrops(RAIN_PARTICLES);
-    initTraffic();
-    spawnVehicles();
-    spawnPeople(18);
-    camTargetX = 0.0f; camTargetZoom = 1.0f; cameraX = 0.0f; cameraZoom = 1.0f;
+void initScene(SceneState &scene){
+    srand(SCENE_SEED ? SCENE_SEED : (unsigned)time(NULL));
+    buildCity(scene);
+    initClouds(scene);
+    initDrops(scene, RAIN_PARTICLES);
+    initTraffic(scene);
+    spawnVehicles(scene);
+    spawnPeople(scene, 18);
+    scene.camTargetX = 0.0f; scene.camTargetZoom = 1.0f; scene.cameraX = 0.0f; scene.cameraZoom = 1.0f;
 }
 
+// resizing only changes how the fixed world is mapped; nothing is regenerated
 void reshape(int w,int h){
-    WIN_W = w; WIN_H = h;
-    glViewport(0,0,w,h);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluOrtho2D(0, WIN_W, 0, WIN_H);
-    glMatrixMode(GL_MODELVIEW);
+    WIN_W = std::max(1, w); WIN_H = std::max(1, h);
+    viewW = WORLD_H * (WIN_W / (float)WIN_H);
+}
+
+// ------------------ Headless offscreen mode ------------------
+// --headless N renders N frames into an EGL pbuffer instead of a window: on the
+// Mesa surfaceless platform when available (llvmpipe, no display or GPU needed),
+// else the default EGL display. The scene runs single-threaded with a fixed
+// seed, each frame is read back with glReadPixels into one reused buffer, and
+// frame times are reported at the end, giving a reproducible baseline of the
+// real GL path. --frames-out DIR also writes every frame as a PPM.
+struct HeadlessOptions {
+    int frames = 0;             // frames [begin, end) of a sequence of this length
+    int begin = 0, end = -1;    // end < 0: up to frames
+    int workers = 0;            // > 0: split across processes (runFrameParallel)
+    std::string outDir;
+    bool report = true;
+};
+
+bool createOffscreenContext(int w, int h){
+#ifdef HEADLESS_EGL
+    EGLDisplay dpy = EGL_NO_DISPLAY;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if(getPlatformDisplay) dpy = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+#endif
+    if(dpy == EGL_NO_DISPLAY) dpy = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if(dpy == EGL_NO_DISPLAY || !eglInitialize(dpy, NULL, NULL)) return false;
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_NONE
+    };
+    EGLConfig config;
+    EGLint count = 0;
+    if(!eglChooseConfig(dpy, configAttribs, &config, 1, &count) || count < 1) return false;
+    const EGLint surfaceAttribs[] = { EGL_WIDTH, w, EGL_HEIGHT, h, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(dpy, config, surfaceAttribs);
+    if(surface == EGL_NO_SURFACE || !eglBindAPI(EGL_OPENGL_API)) return false;
+    EGLContext ctx = eglCreateContext(dpy, config, EGL_NO_CONTEXT, NULL);
+    return ctx != EGL_NO_CONTEXT && eglMakeCurrent(dpy, surface, surface, ctx);
+#else
+    (void)w; (void)h;
+    return false;
+#endif
+}
+
+// binary PPM, top row first (GL rows come bottom-up)
+bool writeFramePPM(const std::string &path, const std::vector<uint8_t> &rgb, int w, int h){
+    FILE *f = fopen(path.c_str(), "wb");
+    if(!f) return false;
+    fprintf(f, "P6\n%d %d\n255\n", w, h);
+    for(int y=h-1; y>=0; --y) fwrite(&rgb[(size_t)y*w*3], 1, (size_t)w*3, f);
+    return fclose(f) == 0;
+}
+
+int runHeadless(const HeadlessOptions &opt){
+    if(!createOffscreenContext(WIN_W, WIN_H)){
+        std::cerr << "No offscreen GL context (build with -DHEADLESS_EGL -lEGL and install Mesa EGL)" << std::endl;
+        return 1;
+    }
+    if(opt.report) std::cout << "GL renderer: " << (const char*)glGetString(GL_RENDERER) << std::endl;
+    if(!SCENE_SEED) SCENE_SEED = 1;
+    reshape(WIN_W, WIN_H);
+    bakeLighting();
+    initScene(simScene);
+
+    // fast-forward: the simulation alone decides what frame `begin` shows
+    int end = opt.end < 0 ? opt.frames : opt.end;
+    for(int f=0; f<opt.begin; ++f) simTick();
+
+    std::vector<uint8_t> pixels((size_t)WIN_W*WIN_H*3);
+    std::vector<double> frameMs, simMs;
+    frameMs.reserve(end - opt.begin); simMs.reserve(end - opt.begin);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for(int f=opt.begin; f<end; ++f){
+        auto t0 = std::chrono::steady_clock::now();
+        simTick();
+        auto t1 = std::chrono::steady_clock::now();
+        { ProfileScope prof(profiler, PROF_FRAME); renderFrame(); }
+        glReadPixels(0, 0, WIN_W, WIN_H, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        auto t2 = std::chrono::steady_clock::now();
+        simMs.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+        frameMs.push_back(std::chrono::duration<double, std::milli>(t2 - t1).count());
+        recordFrameTime((float)frameMs.back());
+        if(!opt.outDir.empty()){
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%05d.ppm", f);
+            if(!writeFramePPM(opt.outDir + name, pixels, WIN_W, WIN_H)){
+                std::cerr << "Cannot write " << opt.outDir << name << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // FNV-1a of the last frame: equal hashes mean identical images
+    uint64_t hash = 1469598103934665603ull;
+    for(uint8_t b : pixels){ hash ^= b; hash *= 1099511628211ull; }
+    double simTotal = 0;
+    for(double v : simMs) simTotal += v;
+    std::vector<double> sorted = frameMs;
+    std::sort(sorted.begin(), sorted.end());
+    double total = 0;
+    for(double v : sorted) total += v;
+    if(!opt.report){
+        printf("frames %d-%d: %.3f ms/frame\n", opt.begin, end - 1, sorted.empty() ? 0.0 : total / sorted.size());
+        return 0;
+    }
+    std::cout << "=== Headless render ===" << std::endl;
+    std::cout << "frames=" << (end - opt.begin) << " size=" << WIN_W << "x" << WIN_H << " seed=" << SCENE_SEED << std::endl;
+    if(!sorted.empty()){
+        printf("render+readback ms: mean %.3f  min %.3f  p50 %.3f  p95 %.3f  max %.3f  (%.1f fps)\n",
+               total / sorted.size(), sorted.front(), sorted[sorted.size()/2], sorted[sorted.size()*95/100], sorted.back(),
+               1000.0 * sorted.size() / total);
+        printf("sim ms: mean %.3f\n", simTotal / simMs.size());
+        printf("last frame hash: %016llx\n", (unsigned long long)hash);
+    }
+    if(profiler.enabled) profiler.printSummary(stdout);
+    return 0;
+}
+
+// Frame-parallel offline render: worker w of W forks, fast-forwards the
+// simulation to frame N*w/W, renders its slice headless into outDir, and the
+// parent stitches frame_*.ppm in order into outDir/sequence.ppm (a
+// concatenated PPM stream). The simulation is deterministic for a seed and
+// rendering does not feed back into it, so the stream is byte-identical to a
+// --workers 1 run.
+int runFrameParallel(const HeadlessOptions &opt){
+#ifdef _WIN32
+    std::cerr << "--workers needs fork(); not available on Windows" << std::endl;
+    return 1;
+#else
+    if(opt.outDir.empty()){
+        std::cerr << "--workers needs --frames-out DIR" << std::endl;
+        return 1;
+    }
+    if(!SCENE_SEED) SCENE_SEED = 1; // every worker must build the same city
+    int workers = std::min(opt.workers, opt.frames);
+    // llvmpipe threads on its own; share the cores out unless told otherwise
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    std::string lpThreads = std::to_string(std::max(1, cores / workers));
+    setenv("LP_NUM_THREADS", lpThreads.c_str(), 0);
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::cout.flush(); fflush(stdout);
+    std::vector<pid_t> pids;
+    for(int w=0; w<workers; ++w){
+        pid_t pid = fork();
+        if(pid < 0){ perror("fork"); break; }
+        if(pid == 0){
+            HeadlessOptions part = opt;
+            part.workers = 0;
+            part.begin = (int)((long long)opt.frames * w / workers);
+            part.end = (int)((long long)opt.frames * (w + 1) / workers);
+            part.report = false;
+            int rc = runHeadless(part);
+            fflush(stdout);
+            _exit(rc);
+        }
+        pids.push_back(pid);
+    }
+    bool ok = (int)pids.size() == workers;
+    for(pid_t pid : pids){
+        int status = 0;
+        ok = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+    }
+    if(!ok){
+        std::cerr << "A render worker failed" << std::endl;
+        return 1;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+
+    // stitch in frame order
+    std::string seqPath = opt.outDir + "/sequence.ppm";
+    FILE *seq = fopen(seqPath.c_str(), "wb");
+    if(!seq){ std::cerr << "Cannot write " << seqPath << std::endl; return 1; }
+    uint64_t hash = 1469598103934665603ull;
+    std::vector<uint8_t> buf;
+    for(int f=0; f<opt.frames; ++f){
+        char name[32];
+        snprintf(name, sizeof(name), "/frame_%05d.ppm", f);
+        FILE *in = fopen((opt.outDir + name).c_str(), "rb");
+        if(!in){ std::cerr << "Missing " << opt.outDir << name << std::endl; fclose(seq); return 1; }
+        fseek(in, 0, SEEK_END); buf.resize((size_t)ftell(in)); fseek(in, 0, SEEK_SET);
+        size_t got = fread(buf.data(), 1, buf.size(), in);
+        fclose(in);
+        fwrite(buf.data(), 1, got, seq);
+        for(size_t k=0; k<got; ++k){ hash ^= buf[k]; hash *= 1099511628211ull; }
+    }
+    fclose(seq);
+    double secs = std::chrono::duration<double>(t1 - t0).count();
+    std::cout << "=== Frame-parallel render ===" << std::endl;
+    printf("frames=%d workers=%d size=%dx%d seed=%u\n", opt.frames, workers, WIN_W, WIN_H, SCENE_SEED);
+    printf("render %.2f s (%.2f frames/s), stitched into %s\n", secs, opt.frames / secs, seqPath.c_str());
+    printf("sequence hash: %016llx\n", (unsigned long long)hash);
+    return 0;
+#endif
 }
 
 int main(int argc,char** argv){
+    HeadlessOptions headless;
+    std::string controlPath;
+    for(int i=1;i<argc;i++){
+        std::string a = argv[i];
+        bool more = i + 1 < argc;
+        if(a == "--profile") ENABLE_PROFILING = true;
+        else if(a == "--headless" && more) headless.frames = std::max(1, atoi(argv[++i]));
+        else if(a == "--frames-out" && more) headless.outDir = argv[++i];
+        else if(a == "--workers" && more) headless.workers = std::max(1, atoi(argv[++i]));
+        else if(a == "--control" && more) controlPath = argv[++i];
+        else if(a == "--seed" && more) SCENE_SEED = (unsigned)strtoul(argv[++i], NULL, 10);
+        else if(a == "--size" && more){
+            if(sscanf(argv[++i], "%dx%d", &WIN_W, &WIN_H) != 2 || WIN_W <= 0 || WIN_H <= 0){
+                std::cerr << "Bad --size, expected WxH" << std::endl;
+                return 1;
+            }
+        }
+    }
+    profiler.enabled = ENABLE_PROFILING;
+    // workers render independently and must stay deterministic, so no live tuning there
+    if(!controlPath.empty() && headless.workers == 0) startControlEndpoint(controlPath);
+    if(headless.frames > 0) return headless.workers > 0 ? runFrameParallel(headless) : runHeadless(headless);
+
     glutInit(&argc, argv);
     glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA);
     glutInitWindowSize(WIN_W, WIN_H);
     glutCreateWindow("City After Rain  Refined Cinematic");
-    initScene();
-    glPointSize(1.2f);
+    bakeLighting();
+    initScene(simScene);
+    publishScene(sceneExchange.back(), simScene);
+    sceneExchange.publish();
     glutDisplayFunc(display);
     glutReshapeFunc(reshape);
     glutKeyboardFunc(keyboard);
     glutSpecialFunc(special);
-    glutTimerFunc(FRAME_MS, animate, 0);
+    if(ENABLE_PIPELINE && std::thread::hardware_concurrency() >= 2){
+        simRunning = true;
+        simThread = std::thread(simulationLoop);
+        // closing the window makes GLUT call exit(): join before the globals the
+        // thread uses (and the joinable std::thread itself) are destroyed
+        atexit(stopSimulation);
+        glutTimerFunc(2, pollScene, 0);
+    } else {
+        glutTimerFunc(FRAME_MS, animate, 0);
+    }
     glutMainLoop();
     return 0;
 }
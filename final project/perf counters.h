@@ -0,0 +1,223 @@
+// perf counters.h
+// Opt-in profiling of named code sections. On Linux each thread opens a
+// perf_event_open group (cycles, instructions, cache misses, branch misses);
+// where that is not allowed (containers, perf_event_paranoid, other OSes)
+// only wall time is recorded.
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum CounterKind { CNT_CYCLES, CNT_INSTRUCTIONS, CNT_CACHE_MISSES, CNT_BRANCH_MISSES, CNT_COUNT };
+
+struct CounterSample {
+    uint64_t ns = 0;
+    uint64_t value[CNT_COUNT] = {0, 0, 0, 0};
+};
+
+// Hardware counters of the calling thread, read as one group.
+class ThreadCounters {
+public:
+    ThreadCounters() {
+        for (int k = 0; k < CNT_COUNT; k++) slot[k] = -1;
+    }
+    ~ThreadCounters() {
+#ifdef __linux__
+        for (int fd : fds) close(fd);
+#endif
+    }
+    ThreadCounters(const ThreadCounters&) = delete;
+    ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+    // true if the cycle counter (the group leader) could be opened
+    bool open() {
+#ifdef __linux__
+        const uint64_t configs[CNT_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                             PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (int k = 0; k < CNT_COUNT; k++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[k];
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.disabled = fds.empty() ? 1 : 0;
+            int leader = fds.empty() ? -1 : fds[0];
+            int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+            if (fd < 0) {
+                if (k == CNT_CYCLES) return false;
+                continue;  // e.g. no cache-miss event in this VM; keep the rest
+            }
+            slot[k] = (int)fds.size();
+            fds.push_back(fd);
+        }
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool available(int k) const { return slot[k] >= 0; }
+
+    void read(CounterSample& s) const {
+#ifdef __linux__
+        if (fds.empty()) return;
+        uint64_t buf[1 + CNT_COUNT];
+        if (::read(fds[0], buf, sizeof(buf)) < (ssize_t)sizeof(uint64_t)) return;
+        for (int k = 0; k < CNT_COUNT; k++) {
+            if (slot[k] >= 0 && (uint64_t)slot[k] < buf[0]) s.value[k] = buf[1 + slot[k]];
+        }
+#else
+        (void)s;
+#endif
+    }
+
+private:
+    std::vector<int> fds;  // fds[0] leads the group
+    int slot[CNT_COUNT];   // position of each counter in a group read, -1 if missing
+};
+
+// Per-section statistics: the most recent call ("frame") and the run total.
+// Sections may be recorded from different threads, and profiling may be
+// switched on or off while they run.
+class PerfProfiler {
+public:
+    std::atomic<bool> enabled{false};
+
+    PerfProfiler(const char* const* sectionNames, int count) : names(sectionNames, sectionNames + count), stats(count) {}
+
+    void sample(CounterSample& s) {
+        ThreadCounters& c = threadCounters();
+        s.ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch()).count();
+        c.read(s);
+    }
+
+    void record(int section, const CounterSample& start, const CounterSample& end) {
+        bool hw[CNT_COUNT];
+        for (int k = 0; k < CNT_COUNT; k++) hw[k] = threadCounters().available(k);
+        std::lock_guard<std::mutex> lock(mutex);
+        Stats& st = stats[section];
+        st.last.ns = end.ns - start.ns;
+        for (int k = 0; k < CNT_COUNT; k++) {
+            st.last.value[k] = end.value[k] - start.value[k];
+            st.counted[k] = hw[k];
+        }
+        st.total.ns += st.last.ns;
+        for (int k = 0; k < CNT_COUNT; k++) st.total.value[k] += st.last.value[k];
+        st.calls++;
+    }
+
+    // latest call of every section
+    void printFrame(FILE* out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        fprintf(out, "%-18s %10s %10s %10s %6s %10s %10s\n", "section", "us", "cycles", "instr", "IPC", "cache-miss", "br-miss");
+        for (size_t i = 0; i < stats.size(); i++) {
+            if (stats[i].calls) printRow(out, names[i], stats[i].last, stats[i].counted, 1);
+        }
+        fprintf(out, "\n");
+    }
+
+    // wall time of the latest call of every section in microseconds, -1 if never called
+    std::vector<double> lastMicros() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<double> us;
+        for (const Stats& st : stats) us.push_back(st.calls ? st.last.ns / 1000.0 : -1.0);
+        return us;
+    }
+
+    const char* sectionName(int i) const { return names[i]; }
+    int sectionCount() const { return (int)names.size(); }
+
+    // run totals, averaged per call
+    void printSummary(FILE* out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        fprintf(out, "=== Profile: mean per call ===\n");
+        fprintf(out, "%-18s %10s %10s %10s %6s %10s %10s %10s\n", "section", "us", "cycles", "instr", "IPC", "cache-miss", "br-miss", "calls");
+        for (size_t i = 0; i < stats.size(); i++) {
+            const Stats& st = stats[i];
+            if (!st.calls) continue;
+            printRow(out, names[i], st.total, st.counted, st.calls, false);
+            fprintf(out, " %10llu\n", (unsigned long long)st.calls);
+        }
+        bool any = false;
+        for (const Stats& st : stats) any = any || st.counted[CNT_CYCLES];
+        if (!any) fprintf(out, "(hardware counters unavailable, wall time only)\n");
+    }
+
+private:
+    struct Stats {
+        CounterSample last, total;
+        bool counted[CNT_COUNT] = {false, false, false, false};
+        uint64_t calls = 0;
+    };
+
+    static ThreadCounters& threadCounters() {
+        thread_local ThreadCounters counters;
+        thread_local bool opened = counters.open();
+        (void)opened;
+        return counters;
+    }
+
+    static void printCount(FILE* out, bool counted, double v) {
+        if (counted) fprintf(out, " %10.0f", v);
+        else fprintf(out, " %10s", "-");
+    }
+
+    static void printRow(FILE* out, const char* name, const CounterSample& s, const bool* counted, uint64_t calls,
+                         bool newline = true) {
+        fprintf(out, "%-18s %10.1f", name, s.ns / 1000.0 / calls);
+        printCount(out, counted[CNT_CYCLES], (double)s.value[CNT_CYCLES] / calls);
+        printCount(out, counted[CNT_INSTRUCTIONS], (double)s.value[CNT_INSTRUCTIONS] / calls);
+        if (counted[CNT_CYCLES] && counted[CNT_INSTRUCTIONS] && s.value[CNT_CYCLES])
+            fprintf(out, " %6.2f", (double)s.value[CNT_INSTRUCTIONS] / s.value[CNT_CYCLES]);
+        else
+            fprintf(out, " %6s", "-");
+        printCount(out, counted[CNT_CACHE_MISSES], (double)s.value[CNT_CACHE_MISSES] / calls);
+        printCount(out, counted[CNT_BRANCH_MISSES], (double)s.value[CNT_BRANCH_MISSES] / calls);
+        if (newline) fprintf(out, "\n");
+    }
+
+    std::vector<const char*> names;
+    std::vector<Stats> stats;
+    std::mutex mutex;
+};
+
+// Records the enclosing block as one call of a section.
+class ProfileScope {
+public:
+    ProfileScope(PerfProfiler& p, int id) : prof(p), section(id), active(p.enabled) {
+        if (active) prof.sample(start);
+    }
+    ~ProfileScope() {
+        if (!active) return;
+        CounterSample end;
+        prof.sample(end);
+        prof.record(section, start, end);
+    }
+
+private:
+    PerfProfiler& prof;
+    int section;
+    bool active;  // fixed at entry, so a toggle mid-section is harmless
+    CounterSample start;
+};
+
+#endif
@@ -0,0 +1,47 @@
+// raster primitives.h
+// Low-level draw primitives of the city scene (DDA line, midpoint circle,
+// filled circle/rect). They emit pixels through a callback: main.cpp passes
+// putPixel (glVertex2i), the regression/benchmark tool passes a bitmap.
+#ifndef RASTER_PRIMITIVES_H
+#define RASTER_PRIMITIVES_H
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+template<class Plot>
+void rasterLineDDA(int x1,int y1,int x2,int y2, Plot plot){
+    int dx = x2-x1, dy=y2-y1;
+    int steps = std::max(abs(dx), abs(dy));
+    if(steps==0){ plot(x1,y1); return; }
+    float x=x1,y=y1, xi=dx/(float)steps, yi=dy/(float)steps;
+    for(int i=0;i<=steps;i++){ plot((int)(x+0.5f),(int)(y+0.5f)); x+=xi; y+=yi; }
+}
+
+template<class Plot>
+void rasterCircleMidpoint(int cx,int cy,int r, Plot plot){
+    int x=0,y=r; int d=1-r;
+    while(x<=y){
+        plot(cx+x, cy+y); plot(cx-x, cy+y);
+        plot(cx+x, cy-y); plot(cx-x, cy-y);
+        plot(cx+y, cy+x); plot(cx-y, cy+x);
+        plot(cx+y, cy-x); plot(cx-y, cy-x);
+        if(d<0) d+=2*x+3; else { d+=2*(x-y)+5; y--; }
+        x++;
+    }
+}
+
+template<class Plot>
+void rasterFilledCircle(int cx,int cy,int r, Plot plot){
+    for(int dy=-r;dy<=r;++dy){
+        int dx = (int)floor(sqrt((double)r*r - dy*dy));
+        for(int x=-dx;x<=dx;++x) plot(cx+x, cy+dy);
+    }
+}
+
+template<class Plot>
+void rasterFilledRect(int x,int y,int w,int h, Plot plot){
+    for(int yy=y; yy<y+h; ++yy) for(int xx=x; xx<x+w; ++xx) plot(xx,yy);
+}
+
+#endif
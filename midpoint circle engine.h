@@ -0,0 +1,103 @@
+// midpoint circle engine.h
+// Platform-independent midpoint circle rasterizer. The arc of the second
+// octant is traced once; the other seven octants are produced from it by
+// sign/swap so each one is written as a contiguous run.
+#ifndef MIDPOINT_CIRCLE_ENGINE_H
+#define MIDPOINT_CIRCLE_ENGINE_H
+
+#include <vector>
+#include "raster bitmap.h"
+
+struct Circle {
+    int xc, yc, r;
+};
+
+struct CirclePoint {
+    int x, y;
+};
+
+// Reusable per-thread storage, so batches do not allocate per circle.
+struct CircleScratch {
+    std::vector<int> ax, ay;
+    std::vector<CirclePoint> points;
+};
+
+// Midpoint Circle Algorithm (same decision rule as circle.cpp): fills the arc
+// from (0, r) to the 45 degree diagonal and returns its length.
+inline size_t midpointArc(int r, CircleScratch& s) {
+    s.ax.clear();
+    s.ay.clear();
+    int x = 0;
+    int y = r;
+    int p = 1 - r;  // Initial decision parameter
+    s.ax.push_back(x);
+    s.ay.push_back(y);
+    while (x < y) {
+        x++;
+        if (p < 0) {
+            p = p + 2 * x + 1;       // E
+        } else {
+            y--;
+            p = p + 2 * (x - y) + 1; // SE
+        }
+        s.ax.push_back(x);
+        s.ay.push_back(y);
+    }
+    return s.ax.size();
+}
+
+// Emit all eight octants of one circle into s.points (appended, one run per
+// octant, in the same order plotCirclePoints uses).
+inline void emitCirclePoints(const Circle& c, CircleScratch& s) {
+    size_t n = midpointArc(c.r, s);
+    size_t base = s.points.size();
+    s.points.resize(base + 8 * n);
+    CirclePoint* out = &s.points[base];
+    const int* ax = s.ax.data();
+    const int* ay = s.ay.data();
+    const int sx[8] = {1, -1, 1, -1, 1, -1, 1, -1};
+    const int sy[8] = {1, 1, -1, -1, 1, 1, -1, -1};
+    for (int o = 0; o < 8; o++) {
+        const int* u = o < 4 ? ax : ay;
+        const int* v = o < 4 ? ay : ax;
+        int mx = sx[o], my = sy[o];
+        for (size_t i = 0; i < n; i++) {
+            out[i].x = c.xc + mx * u[i];
+            out[i].y = c.yc + my * v[i];
+        }
+        out += n;
+    }
+}
+
+// Plot one circle outline into a bitmap. Circles fully inside the bitmap take
+// an unclipped path.
+inline void rasterizeCircle(const Circle& c, Bitmap& bmp, CircleScratch& s) {
+    if (c.r < 0) return;
+    size_t n = midpointArc(c.r, s);
+    const int* ax = s.ax.data();
+    const int* ay = s.ay.data();
+    bool inside = c.xc - c.r >= 0 && c.yc - c.r >= 0 && c.xc + c.r < bmp.w && c.yc + c.r < bmp.h;
+    const int sx[8] = {1, -1, 1, -1, 1, -1, 1, -1};
+    const int sy[8] = {1, 1, -1, -1, 1, 1, -1, -1};
+    for (int o = 0; o < 8; o++) {
+        const int* u = o < 4 ? ax : ay;
+        const int* v = o < 4 ? ay : ax;
+        int mx = sx[o], my = sy[o];
+        if (inside) {
+            uint8_t* px = bmp.px.data();
+            for (size_t i = 0; i < n; i++) px[(size_t)(c.yc + my * v[i]) * bmp.w + c.xc + mx * u[i]] = 255;
+        } else {
+            for (size_t i = 0; i < n; i++) bmp.set(c.xc + mx * u[i], c.yc + my * v[i]);
+        }
+    }
+}
+
+// Rasterize a batch, optionally splitting the circles across threads.
+inline void rasterizeCircles(const Circle* circles, size_t count, Bitmap& bmp, int threads = 1) {
+    rasterizeParallel(bmp, count, threads, [circles](Bitmap& target, size_t begin, size_t end) {
+        CircleScratch scratch;
+        for (size_t i = begin; i < end; i++) rasterizeCircle(circles[i], target, scratch);
+    });
+}
+
+#endif
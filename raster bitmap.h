@@ -0,0 +1,200 @@
+// raster bitmap.h
+// CPU-side helpers shared by the batch rasterizers: an 8-bit coverage bitmap,
+// PGM input/output, a read-only memory-mapped file, an integer text parser and
+// a thread splitter.
+#ifndef RASTER_BITMAP_H
+#define RASTER_BITMAP_H
+
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#ifdef _WIN32
+// keep windows.h from defining min/max macros that break std::max/std::min
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Coverage bitmap with the OpenGL convention: (0,0) is the bottom-left pixel.
+struct Bitmap {
+    int w = 0, h = 0;
+    std::vector<uint8_t> px;
+
+    Bitmap() {}
+    Bitmap(int width, int height) : w(width), h(height), px((size_t)width * height, 0) {}
+
+    void clear() { std::fill(px.begin(), px.end(), 0); }
+
+    // clipped plot; out-of-range pixels are dropped like GL would
+    void set(int x, int y, uint8_t v = 255) {
+        if ((unsigned)x < (unsigned)w && (unsigned)y < (unsigned)h) px[(size_t)y * w + x] = v;
+    }
+    uint8_t get(int x, int y) const { return px[(size_t)y * w + x]; }
+
+    // combine another bitmap of the same size (max keeps coverage order-independent)
+    void merge(const Bitmap& o) {
+        for (size_t i = 0; i < px.size(); i++) px[i] = (std::max)(px[i], o.px[i]);  // parenthesized: immune to a min/max macro
+    }
+
+    size_t countSet() const {
+        size_t n = 0;
+        for (uint8_t v : px) n += (v != 0);
+        return n;
+    }
+};
+
+// Binary PGM, written top row first so the image looks like the GL window.
+inline bool writePGM(const Bitmap& bmp, const std::string& path) {
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) return false;
+    fprintf(f, "P5\n%d %d\n255\n", bmp.w, bmp.h);
+    for (int y = bmp.h - 1; y >= 0; y--) fwrite(&bmp.px[(size_t)y * bmp.w], 1, bmp.w, f);
+    return fclose(f) == 0;
+}
+
+inline bool readPGM(Bitmap& bmp, const std::string& path) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return false;
+    int w, h, maxv;
+    if (fscanf(f, "P5 %d %d %d", &w, &h, &maxv) != 3 || maxv != 255 || fgetc(f) == EOF) {
+        fclose(f);
+        return false;
+    }
+    bmp = Bitmap(w, h);
+    bool ok = true;
+    for (int y = h - 1; y >= 0 && ok; y--) ok = fread(&bmp.px[(size_t)y * w], 1, w, f) == (size_t)w;
+    fclose(f);
+    return ok;
+}
+
+// Read-only view of a whole file, mapped rather than copied.
+class MappedFile {
+public:
+    MappedFile() {}
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER sz;
+        if (!GetFileSizeEx(file, &sz)) return false;
+        len = (size_t)sz.QuadPart;
+        if (len == 0) return true;
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping) return false;
+        ptr = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        return ptr != NULL;
+#else
+        fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) return false;
+        len = (size_t)st.st_size;
+        if (len == 0) return true;
+        void* p = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) return false;
+        madvise(p, len, MADV_SEQUENTIAL);
+        ptr = (const char*)p;
+        return true;
+#endif
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (ptr) UnmapViewOfFile(ptr);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (ptr) munmap((void*)ptr, len);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+#endif
+        ptr = NULL;
+        len = 0;
+    }
+
+    const char* data() const { return ptr; }
+    size_t size() const { return len; }
+
+private:
+    const char* ptr = NULL;
+    size_t len = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#else
+    int fd = -1;
+#endif
+};
+
+// Parse whitespace/comma separated integers ('#' starts a comment) straight
+// out of a buffer that need not be NUL-terminated, e.g. a MappedFile.
+// Values outside the int range are rejected like any other malformed input.
+inline bool parseIntText(const char* p, const char* end, std::vector<int>& out) {
+    while (p < end) {
+        char c = *p;
+        if (c == '#') {
+            while (p < end && *p != '\n') p++;
+        } else if (c == '-' || (c >= '0' && c <= '9')) {
+            bool neg = (c == '-');
+            if (neg) p++;
+            if (p >= end || *p < '0' || *p > '9') return false;
+            const long long limit = neg ? -(long long)INT_MIN : INT_MAX;
+            long long v = 0;
+            while (p < end && *p >= '0' && *p <= '9') {
+                v = v * 10 + (*p++ - '0');
+                if (v > limit) return false;
+            }
+            out.push_back((int)(neg ? -v : v));
+        } else if (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',') {
+            p++;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Split [0, count) into one contiguous slice per worker, give each worker its
+// own bitmap, then merge them into `out`. With one thread nothing is spawned.
+inline void rasterizeParallel(Bitmap& out, size_t count, int threads,
+                              const std::function<void(Bitmap&, size_t, size_t)>& work) {
+    if (threads < 1) threads = 1;
+    if ((size_t)threads > count) threads = count ? (int)count : 1;
+    if (threads == 1) {
+        work(out, 0, count);
+        return;
+    }
+    std::vector<Bitmap> local(threads, Bitmap(out.w, out.h));
+    std::vector<std::thread> pool;
+    for (int t = 0; t < threads; t++) {
+        size_t begin = count * t / threads, end = count * (t + 1) / threads;
+        pool.emplace_back([&, t, begin, end] { work(local[t], begin, end); });
+    }
+    for (auto& th : pool) th.join();
+    for (auto& b : local) out.merge(b);
+}
+
+#endif
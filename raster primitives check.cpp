@@ -0,0 +1,191 @@
+// raster primitives check.cpp
+// Golden-image regression check and microbenchmark for the raster primitives:
+//   drawLineDDA, drawCircleMidpoint, drawFilledCircle, drawFilledRect  (final project/main.cpp)
+//   ddaLine                                                            (dda line drawing algorithm.cpp)
+//   midpointCircle                                                     (circle.cpp)
+// Each primitive is rendered into a CPU bitmap through the same rasterizer the
+// program uses, so no window or GL context is needed.
+//
+// Usage:
+//   raster_check --bless [dir]   render every case and store it as the golden image
+//   raster_check --check [dir]   render every case and compare against the goldens (default)
+//   raster_check --bench         ns/pixel and primitives/s for every primitive
+// The golden directory defaults to "golden" (run from the repository root).
+// golden/ is committed and was blessed from the original, pre-refactor
+// rasterizers, so --check must pass on every change. Only re-bless when a
+// primitive's output is meant to change, and commit the new images with it.
+// A failing case also writes <case>.actual.pgm next to its golden image.
+//
+// Compile: g++ "raster primitives check.cpp" -o raster_check -O2 -std=c++11 -pthread
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include "raster bitmap.h"
+#include "dda line kernels.h"
+#include "midpoint circle engine.h"
+#include "final project/raster primitives.h"
+
+using namespace std;
+
+// Every case is drawn into a TILE x TILE bitmap with the origin in the middle,
+// so negative coordinates stay visible; anything past the edge is clipped.
+const int TILE = 96;
+const int ORIGIN = TILE / 2;
+
+enum Primitive { LINE_DDA, CIRCLE_MIDPOINT, FILLED_CIRCLE, FILLED_RECT, DDA_LINE, MIDPOINT_CIRCLE, PRIMITIVE_COUNT };
+
+const char* primitiveNames[PRIMITIVE_COUNT] = {
+    "drawLineDDA", "drawCircleMidpoint", "drawFilledCircle", "drawFilledRect", "ddaLine", "midpointCircle"
+};
+
+struct Case {
+    Primitive prim;
+    int a, b, c, d;  // line: x1 y1 x2 y2; circle: cx cy r; rect: x y w h
+};
+
+template <class Plot>
+void drawPrimitive(const Case& k, Plot plot) {
+    switch (k.prim) {
+        case LINE_DDA: rasterLineDDA(k.a, k.b, k.c, k.d, plot); break;
+        case CIRCLE_MIDPOINT: rasterCircleMidpoint(k.a, k.b, k.c, plot); break;
+        case FILLED_CIRCLE: rasterFilledCircle(k.a, k.b, k.c, plot); break;
+        case FILLED_RECT: rasterFilledRect(k.a, k.b, k.c, k.d, plot); break;
+        case DDA_LINE: ddaLineKernel(k.a, k.b, k.c, k.d, plot); break;
+        case MIDPOINT_CIRCLE: {
+            static CircleScratch scratch;
+            scratch.points.clear();
+            emitCirclePoints({k.a, k.b, k.c}, scratch);
+            for (const CirclePoint& p : scratch.points) plot(p.x, p.y);
+            break;
+        }
+        default: break;
+    }
+}
+
+// Parameter grid, edge cases first: zero length, axis-aligned, 45 degrees,
+// steep and shallow slopes both ways, negative and clipped coordinates.
+vector<Case> buildCases() {
+    vector<Case> cases;
+    const int lines[][4] = {
+        {0, 0, 0, 0}, {-7, -9, -7, -9}, {-40, 0, 40, 0}, {0, -40, 0, 40}, {-30, -30, 30, 30},
+        {30, -30, -30, 30}, {0, 0, 3, 44}, {0, 0, -3, -44}, {-44, 2, 44, -5}, {5, 5, -41, 17},
+        {-20, -45, 21, 46}, {-90, -10, 90, 12}, {1, 2, 2, 1}, {-1, -1, 0, 0}
+    };
+    const int circles[][3] = {
+        {0, 0, 0}, {0, 0, 1}, {0, 0, 2}, {3, -4, 5}, {-10, 7, 17}, {0, 0, 40}, {-40, -40, 30}, {20, 30, 60}
+    };
+    const int rects[][4] = {
+        {0, 0, 0, 0}, {0, 0, 1, 1}, {-10, -5, 20, 10}, {-60, -60, 40, 30}, {30, 30, 40, 40}, {5, 5, 0, 12}, {-3, -20, 1, 40}
+    };
+    for (Primitive p : {LINE_DDA, DDA_LINE})
+        for (auto& l : lines) cases.push_back({p, l[0], l[1], l[2], l[3]});
+    for (Primitive p : {CIRCLE_MIDPOINT, FILLED_CIRCLE, MIDPOINT_CIRCLE})
+        for (auto& c : circles) cases.push_back({p, c[0], c[1], c[2], 0});
+    for (auto& r : rects) cases.push_back({FILLED_RECT, r[0], r[1], r[2], r[3]});
+    return cases;
+}
+
+string caseName(const Case& k, int index) {
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s_%02d", primitiveNames[k.prim], index);
+    return buf;
+}
+
+Bitmap renderCase(const Case& k) {
+    Bitmap bmp(TILE, TILE);
+    drawPrimitive(k, [&bmp](int x, int y) { bmp.set(x + ORIGIN, y + ORIGIN); });
+    return bmp;
+}
+
+int runGolden(const string& dir, bool bless) {
+    vector<Case> cases = buildCases();
+    int failures = 0;
+    int perPrim[PRIMITIVE_COUNT] = {0};
+    for (const Case& k : cases) {
+        string name = caseName(k, perPrim[k.prim]++);
+        string path = dir + "/" + name + ".pgm";
+        Bitmap got = renderCase(k);
+        if (bless) {
+            if (!writePGM(got, path)) {
+                cerr << "Cannot write " << path << " (does the directory exist?)" << endl;
+                return 1;
+            }
+            continue;
+        }
+        Bitmap want;
+        if (!readPGM(want, path)) {
+            cout << "FAIL " << name << ": no golden image at " << path << " (run --bless first)" << endl;
+            failures++;
+            continue;
+        }
+        size_t diff = 0;
+        if (want.w != got.w || want.h != got.h) diff = got.px.size();
+        else for (size_t i = 0; i < got.px.size(); i++) diff += (got.px[i] != want.px[i]);
+        if (diff) {
+            cout << "FAIL " << name << ": " << diff << " pixels differ" << endl;
+            writePGM(got, dir + "/" + name + ".actual.pgm");
+            failures++;
+        }
+    }
+    if (bless) {
+        cout << "Blessed " << cases.size() << " golden images into " << dir << endl;
+        return 0;
+    }
+    cout << (cases.size() - failures) << "/" << cases.size() << " cases match" << endl;
+    return failures ? 1 : 0;
+}
+
+// ---------------- Microbenchmarks ----------------
+
+vector<Case> benchCases(Primitive p, size_t n) {
+    mt19937 rng(7);
+    uniform_int_distribution<int> pos(0, 511), len(-64, 64), rad(0, 40), size(1, 48);
+    vector<Case> cases;
+    for (size_t i = 0; i < n; i++) {
+        Case k = {p, pos(rng), pos(rng), 0, 0};
+        if (p == LINE_DDA || p == DDA_LINE) { k.c = k.a + len(rng); k.d = k.b + len(rng); }
+        else if (p == FILLED_RECT) { k.c = size(rng); k.d = size(rng); }
+        else k.c = rad(rng);
+        cases.push_back(k);
+    }
+    return cases;
+}
+
+int runBench() {
+    const size_t N = 4096;
+    Bitmap bmp(512, 512);
+    cout << "primitive            prims/s        ns/pixel" << endl;
+    for (int p = 0; p < PRIMITIVE_COUNT; p++) {
+        vector<Case> cases = benchCases((Primitive)p, N);
+        size_t pixels = 0;
+        for (const Case& k : cases) drawPrimitive(k, [&pixels](int, int) { pixels++; });
+
+        // repeat the whole set until at least 200 ms have passed
+        size_t rounds = 0;
+        double ms = 0;
+        auto t0 = chrono::steady_clock::now();
+        do {
+            for (const Case& k : cases) drawPrimitive(k, [&bmp](int x, int y) { bmp.set(x, y); });
+            rounds++;
+            ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        } while (ms < 200.0);
+
+        double prims = (double)rounds * N;
+        printf("%-20s %-14.4g %.3f\n", primitiveNames[p], prims / ms * 1000.0, ms * 1e6 / (pixels * (double)rounds));
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    string mode = argc > 1 ? argv[1] : "--check";
+    string dir = argc > 2 ? argv[2] : "golden";
+    if (mode == "--bless") return runGolden(dir, true);
+    if (mode == "--check") return runGolden(dir, false);
+    if (mode == "--bench") return runBench();
+    cerr << "Usage: " << argv[0] << " [--check|--bless] [dir] | --bench" << endl;
+    return 1;
+}